@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <folly/synchronization/AtomicNotification.h>
+
+namespace logai {
+
+/**
+ * @brief Fixed-capacity lock-free multi-producer multi-consumer queue.
+ *
+ * Slots form a ring, each with a sequence number that tells producers and
+ * consumers whose turn it is (Vyukov's bounded MPMC design), so push and pop
+ * are a CAS on a shared position plus a release store on the slot. Blocking
+ * push/pop sleep on futex-backed counters (folly::atomic_wait) rather than
+ * a mutex, and only pay for a wake-up when someone is actually waiting.
+ * A full queue blocks producers, which is what bounds pipeline memory.
+ *
+ * Same interface as ThreadSafeQueue, plus try_push and capacity().
+ */
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : mask_(round_up_pow2(capacity) - 1),
+          slots_(new Slot[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /** Move `value` in if there is room; leaves it untouched otherwise. */
+    bool try_push(T& value) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = std::move(value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        signal(items_, pop_waiters_);
+        return true;
+    }
+
+    /** Push, waiting for a free slot while the queue is full. */
+    void push(T value) {
+        while (!try_push(value)) {
+            uint32_t epoch = space_.load();
+            push_waiters_.fetch_add(1);
+            // Re-check after registering so a pop between the failed attempt
+            // and the wait cannot be missed
+            bool pushed = try_push(value);
+            if (!pushed) {
+                folly::atomic_wait(&space_, epoch);
+            }
+            push_waiters_.fetch_sub(1);
+            if (pushed) {
+                return;
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // Empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(slot->value);
+        slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        signal(space_, push_waiters_);
+        return true;
+    }
+
+    /**
+     * Pop, waiting while the queue is empty. Returns false once done() has
+     * been called and every pushed item has been taken.
+     */
+    bool wait_and_pop(T& value) {
+        while (true) {
+            if (try_pop(value)) {
+                return true;
+            }
+            if (done_.load()) {
+                // Items pushed before done() are still visible here
+                return try_pop(value);
+            }
+            uint32_t epoch = items_.load();
+            pop_waiters_.fetch_add(1);
+            if (try_pop(value)) {
+                pop_waiters_.fetch_sub(1);
+                return true;
+            }
+            if (!done_.load()) {
+                folly::atomic_wait(&items_, epoch);
+            }
+            pop_waiters_.fetch_sub(1);
+        }
+    }
+
+    /** No more items will be pushed; wakes every waiting consumer. */
+    void done() {
+        done_.store(true);
+        items_.fetch_add(1);
+        folly::atomic_notify_all(&items_);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t size() const {
+        size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    size_t capacity() const {
+        return mask_ + 1;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t round_up_pow2(size_t n) {
+        size_t capacity = 2;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // Bump an event counter and wake sleepers on it, if there are any
+    static void signal(std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiters) {
+        events.fetch_add(1);
+        if (waiters.load() != 0) {
+            folly::atomic_notify_all(&events);
+        }
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+
+    // Futex words: `items_` advances on every push (and done()), `space_`
+    // on every pop
+    alignas(64) std::atomic<uint32_t> items_{0};
+    std::atomic<uint32_t> pop_waiters_{0};
+    alignas(64) std::atomic<uint32_t> space_{0};
+    std::atomic<uint32_t> push_waiters_{0};
+
+    alignas(64) std::atomic<bool> done_{false};
+};
+
+} // namespace logai
@@ -32,5 +32,7 @@ struct DataLoaderConfig {
     int drain_depth = 4;
     double drain_similarity_threshold = 0.5;
     int drain_max_children = 100;
+    // Least recently matched clusters are evicted beyond this many; 0 = unbounded
+    size_t drain_max_clusters = 0;
 };
 } 
\ No newline at end of file
@@ -4,28 +4,45 @@
 #include "drain_parser.h"
 #include "log_record.h"
 #include "data_loader_config.h"
+#include "log_prefix_matcher.h"
+#include "memory_mapped_file.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cctype>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
 #include <iostream>
 #include <chrono>
+#include <limits>
 #include <numeric>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
 
 
 // Folly includes
+#include <folly/Range.h>
 #include <folly/container/F14Map.h>
 #include <folly/container/F14Set.h>
 #include <folly/String.h>
+#include <folly/SharedMutex.h>
 #include <folly/Synchronized.h>
 #include <folly/small_vector.h>
 #include <spdlog/spdlog.h>
 
 #include <regex>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
 namespace logai {
 
 constexpr char WILDCARD[] = "<*>";
@@ -70,53 +87,298 @@ bool is_number(std::string_view str) {
     return true;
 }
 
+// ----------------------------------------------------------------------------
+// Token dictionary
+// ----------------------------------------------------------------------------
+
+using TokenIdVector = folly::small_vector<uint32_t, 16>;
+
+// Token IDs carry their class in the top bit so the hot path never has to
+// re-run is_number() on a token it has already seen.
+constexpr uint32_t kNumberTokenBit = 0x80000000u;
+constexpr uint32_t kWildcardToken = 0;
+// Never assigned; stands in for tokens absent from the dictionary so they
+// cannot compare equal to any cluster token
+constexpr uint32_t kUnknownToken = 0x7FFFFFFFu;
+
+inline bool is_number_token(uint32_t id) {
+    return (id & kNumberTokenBit) != 0;
+}
+
+/**
+ * Maps each distinct token to a stable 32-bit ID. Token bytes live in a
+ * StringPool, so IDs can be turned back into text for templates.
+ */
+class TokenDictionary {
+public:
+    TokenDictionary() {
+        // Slot 0 is the wildcard
+        state_.wlock()->by_index.push_back(WILDCARD);
+    }
+
+    /**
+     * Look every token up without inserting. Unknown tokens become
+     * kUnknownToken (with the number bit set if they are numeric).
+     * Returns the number of unknown tokens.
+     */
+    size_t encode(const TokenVector& tokens, TokenIdVector& ids) const {
+        auto state = state_.rlock();
+        return encode_locked(*state, tokens, ids);
+    }
+
+    /**
+     * encode() for many lines under a single read lock.
+     */
+    void encode_batch(const std::vector<TokenVector>& lines,
+                      std::vector<TokenIdVector>& ids,
+                      std::vector<size_t>& unknown) const {
+        ids.resize(lines.size());
+        unknown.resize(lines.size());
+        auto state = state_.rlock();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            unknown[i] = encode_locked(*state, lines[i], ids[i]);
+        }
+    }
+
+    /**
+     * Replace the kUnknownToken entries produced by encode() with real IDs.
+     */
+    void intern_unknown(const TokenVector& tokens, TokenIdVector& ids) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if ((ids[i] & ~kNumberTokenBit) == kUnknownToken) {
+                ids[i] = intern(tokens[i]);
+            }
+        }
+    }
+
+    uint32_t intern(std::string_view token) {
+        {
+            auto state = state_.rlock();
+            auto it = state->ids.find(token);
+            if (it != state->ids.end()) {
+                return it->second;
+            }
+        }
+        const bool numeric = is_number(token);
+        auto state = state_.wlock();
+        auto it = state->ids.find(token);
+        if (it != state->ids.end()) {
+            return it->second;
+        }
+        std::string_view stored = pool_->intern(token);
+        uint32_t id = static_cast<uint32_t>(state->by_index.size());
+        if (numeric) {
+            id |= kNumberTokenBit;
+        }
+        state->by_index.push_back(stored);
+        state->ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view text(uint32_t id) const {
+        if (id == kWildcardToken) {
+            return WILDCARD;
+        }
+        auto state = state_.rlock();
+        size_t index = id & ~kNumberTokenBit;
+        return index < state->by_index.size() ? state->by_index[index] : std::string_view();
+    }
+
+    size_t size() const {
+        return state_.rlock()->by_index.size();
+    }
+
+    /**
+     * Approximate bytes held by the token bytes, the index and the ID table.
+     */
+    size_t memory_bytes() const {
+        auto state = state_.rlock();
+        return pool_->arena_bytes() +
+               state->ids.size() * (sizeof(std::string_view) + sizeof(uint32_t)) +
+               state->by_index.capacity() * sizeof(std::string_view);
+    }
+
+    /**
+     * Every (token, ID) pair, excluding the wildcard. The views point into
+     * the dictionary's pool and stay valid for its lifetime.
+     */
+    std::vector<std::pair<std::string_view, uint32_t>> entries() const {
+        auto state = state_.rlock();
+        return {state->ids.begin(), state->ids.end()};
+    }
+
+    /**
+     * Load (token, ID) pairs saved from another dictionary so existing
+     * token IDs keep their meaning. Only valid on an empty dictionary, and
+     * the IDs must be dense as intern() hands them out.
+     */
+    bool restore(std::vector<std::pair<std::string_view, uint32_t>> entries) {
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+            return (a.second & ~kNumberTokenBit) < (b.second & ~kNumberTokenBit);
+        });
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if ((entries[i].second & ~kNumberTokenBit) != i + 1) {
+                return false;
+            }
+        }
+        auto state = state_.wlock();
+        if (state->by_index.size() != 1) {
+            return false;
+        }
+        for (const auto& [token, id] : entries) {
+            std::string_view stored = pool_->intern(token);
+            state->by_index.push_back(stored);
+            state->ids.emplace(stored, id);
+        }
+        return true;
+    }
+
+    /**
+     * Drop every token not in `live` and renumber the rest densely, keeping
+     * their order and number bit. Returns the new ID for each old index
+     * (kUnknownToken for dropped ones). Views from text() and entries()
+     * are invalidated, and the caller must rewrite every ID it holds.
+     */
+    std::vector<uint32_t> compact(const std::vector<uint32_t>& live) {
+        auto state = state_.wlock();
+        const size_t old_size = state->by_index.size();
+        std::vector<bool> keep(old_size, false);
+        for (uint32_t id : live) {
+            const size_t index = id & ~kNumberTokenBit;
+            if (index < old_size) {
+                keep[index] = true;
+            }
+        }
+
+        auto pool = std::make_unique<StringPool>();
+        State compacted;
+        compacted.by_index.push_back(WILDCARD);
+        std::vector<uint32_t> remap(old_size, kUnknownToken);
+        remap[0] = kWildcardToken;
+        for (size_t index = 1; index < old_size; ++index) {
+            if (!keep[index]) {
+                continue;
+            }
+            const std::string_view token = state->by_index[index];
+            const uint32_t number_bit = state->ids.find(token)->second & kNumberTokenBit;
+            const uint32_t id = static_cast<uint32_t>(compacted.by_index.size()) | number_bit;
+            const std::string_view stored = pool->intern(token);
+            compacted.by_index.push_back(stored);
+            compacted.ids.emplace(stored, id);
+            remap[index] = id;
+        }
+        *state = std::move(compacted);
+        pool_ = std::move(pool);
+        return remap;
+    }
+
+private:
+    struct State {
+        folly::F14FastMap<std::string_view, uint32_t> ids;
+        std::vector<std::string_view> by_index;
+    };
+
+    static size_t encode_locked(const State& state, const TokenVector& tokens, TokenIdVector& ids) {
+        ids.clear();
+        ids.reserve(tokens.size());
+        size_t unknown = 0;
+        for (std::string_view token : tokens) {
+            auto it = state.ids.find(token);
+            if (it != state.ids.end()) {
+                ids.push_back(it->second);
+            } else {
+                ids.push_back(is_number(token) ? (kUnknownToken | kNumberTokenBit) : kUnknownToken);
+                ++unknown;
+            }
+        }
+        return unknown;
+    }
+
+    // Replaced by compact(); only touched under the state lock
+    std::unique_ptr<StringPool> pool_ = std::make_unique<StringPool>();
+    folly::Synchronized<State> state_;
+};
+
+/**
+ * Count positions where a cluster row matches the line, treating wildcard
+ * cells in the row as matches.
+ */
+inline size_t count_token_matches(const uint32_t* row, const uint32_t* line, size_t n) {
+    size_t common = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i wildcard = _mm256_set1_epi32(static_cast<int>(kWildcardToken));
+    for (; i + 8 <= n; i += 8) {
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(line + i));
+        const __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi32(r, l),
+                                            _mm256_cmpeq_epi32(r, wildcard));
+        common += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+    }
+#elif defined(__SSE4_2__)
+    const __m128i wildcard = _mm_set1_epi32(static_cast<int>(kWildcardToken));
+    for (; i + 4 <= n; i += 4) {
+        const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + i));
+        const __m128i hit = _mm_or_si128(_mm_cmpeq_epi32(r, l),
+                                         _mm_cmpeq_epi32(r, wildcard));
+        common += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+    }
+#endif
+    for (; i < n; ++i) {
+        if (row[i] == line[i] || row[i] == kWildcardToken) {
+            ++common;
+        }
+    }
+    return common;
+}
+
+/**
+ * Holds the user-supplied preprocess patterns. The built-in header forms are
+ * handled by LogPrefixMatcher, so the regex engine only runs when a caller
+ * installed patterns of its own. Readers take a snapshot of the pattern list
+ * so replacing it never races with an in-flight parse.
+ */
 class RegexCache {
 public:
+    using PatternList = std::vector<std::regex>;
+
     static RegexCache& instance() {
         static RegexCache cache;
         return cache;
     }
 
-    const std::vector<std::regex>& get_default_patterns() const {
-        return default_patterns_;
-    }
-
-    void set_custom_patterns(std::vector<std::regex> patterns) {
-        custom_patterns_ = std::move(patterns);
+    void set_custom_patterns(PatternList patterns) {
+        std::shared_ptr<const PatternList> next;
+        if (!patterns.empty()) {
+            next = std::make_shared<const PatternList>(std::move(patterns));
+        }
+        std::atomic_store(&custom_patterns_, std::move(next));
     }
 
-    const std::vector<std::regex>& get_patterns() const {
-        // If custom patterns exist, use them; else use default
-        if (!custom_patterns_.empty()) {
-            return custom_patterns_;
-        }
-        return default_patterns_;
+    // Null when no custom patterns are installed
+    std::shared_ptr<const PatternList> get_custom_patterns() const {
+        return std::atomic_load(&custom_patterns_);
     }
 
 private:
-    RegexCache() {
-        // Some default patterns for trimming timestamps, brackets, etc.
-        default_patterns_.emplace_back(R"(^\[.*?\]\s*)");
-        default_patterns_.emplace_back(R"(^\d{4}[-/]\d{1,2}[-/]\d{1,2}\s+\d{1,2}:\d{1,2}:\d{1,2}(?:\.\d+)?\s+)");
-        default_patterns_.emplace_back(R"(^\d{1,2}:\d{1,2}:\d{1,2}(?:\.\d+)?\s+)");
-        default_patterns_.emplace_back(R"((?i)^\s*(?:ERROR|WARN(?:ING)?|INFO|DEBUG|TRACE|FATAL)\s*:?\s*)");
-        default_patterns_.emplace_back(R"(^\w+\s+\w+\s+\d+\s+\d{2}:\d{2}:\d{2}\s+\d{4}\s+)");
-        default_patterns_.emplace_back(R"(^\d{4}-\d{2}-\d{2}T\d{2}:\d{2}:\d{2}(?:\.\d+)?(?:Z|[+-]\d{2}:?\d{2})?\s+)");
-    }
-
-    std::vector<std::regex> default_patterns_;
-    std::vector<std::regex> custom_patterns_;
+    RegexCache() = default;
+
+    std::shared_ptr<const PatternList> custom_patterns_;
 };
 
-// Preprocess log using regex patterns
-std::string_view preprocess_log(std::string_view line) {
-    const auto& patterns = RegexCache::instance().get_patterns();
-    // We work on a temporary std::string to run regex searches
-    std::string line_str(line);
+// Strip a leading timestamp/level header so only the message is clustered.
+// `custom` is a pattern list snapshot; null means the built-in headers.
+std::string_view preprocess_log(std::string_view line, const RegexCache::PatternList* custom) {
+    if (!custom) {
+        return line.substr(LogPrefixMatcher::strip_length(line));
+    }
 
-    for (const auto& pattern : patterns) {
-        std::smatch match;
-        if (std::regex_search(line_str, match, pattern)) {
+    const char* begin = line.data();
+    const char* end = begin + line.size();
+    for (const auto& pattern : *custom) {
+        std::cmatch match;
+        if (std::regex_search(begin, end, match, pattern)) {
             size_t content_start = match.position() + match.length();
             if (content_start < line.size()) {
                 return line.substr(content_start);
@@ -126,6 +388,11 @@ std::string_view preprocess_log(std::string_view line) {
     return line;
 }
 
+std::string_view preprocess_log(std::string_view line) {
+    const auto custom = RegexCache::instance().get_custom_patterns();
+    return preprocess_log(line, custom.get());
+}
+
 } // namespace detail
 
 
@@ -133,31 +400,860 @@ std::string_view preprocess_log(std::string_view line) {
 // DRAIN Structures
 // ============================================================================
 
+/**
+ * Hit counters for one cluster, updated lock-free from the match path.
+ *
+ * Per-minute counts live in a ring of 64-bit words, each packing the minute
+ * it belongs to (high half) with its count (low half), so a slot is claimed
+ * for a new minute and incremented with a single CAS. The struct gets its
+ * own cache lines so hit counting never invalidates the template fields that
+ * concurrent matchers are reading.
+ */
+struct alignas(64) ClusterStats {
+    static constexpr size_t kMinutes = 60;
+
+    std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> first_seen_ms{std::numeric_limits<int64_t>::max()};
+    std::atomic<int64_t> last_seen_ms{0};
+    std::array<std::atomic<uint64_t>, kMinutes> per_minute{};
+
+    void record(uint64_t hits, int64_t now_ms) {
+        count.fetch_add(hits, std::memory_order_relaxed);
+        atomic_min(first_seen_ms, now_ms);
+        atomic_max(last_seen_ms, now_ms);
+        add_to_minute(static_cast<uint64_t>(now_ms / 60000), hits);
+    }
+
+    /**
+     * Fold another cluster's counters into this one (see DrainParser::merge).
+     */
+    void absorb(const ClusterStats& other) {
+        count.fetch_add(other.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        atomic_min(first_seen_ms, other.first_seen_ms.load(std::memory_order_relaxed));
+        atomic_max(last_seen_ms, other.last_seen_ms.load(std::memory_order_relaxed));
+        for (const auto& slot : other.per_minute) {
+            const uint64_t packed = slot.load(std::memory_order_relaxed);
+            if (packed != 0) {
+                add_to_minute(packed >> 32, packed & 0xFFFFFFFFu);
+            }
+        }
+    }
+
+    /**
+     * Hits in the `minutes.size()` minutes ending at `now_ms`, newest first.
+     */
+    void minutes_ending_at(int64_t now_ms, std::vector<uint32_t>& minutes) const {
+        const uint64_t now_minute = static_cast<uint64_t>(now_ms / 60000);
+        for (size_t age = 0; age < minutes.size() && age <= now_minute; ++age) {
+            const uint64_t minute = now_minute - age;
+            const uint64_t packed = per_minute[minute % kMinutes].load(std::memory_order_relaxed);
+            minutes[age] = (packed >> 32) == minute ? static_cast<uint32_t>(packed) : 0;
+        }
+    }
+
+private:
+    void add_to_minute(uint64_t minute, uint64_t hits) {
+        auto& slot = per_minute[minute % kMinutes];
+        uint64_t packed = slot.load(std::memory_order_relaxed);
+        while (true) {
+            const uint64_t slot_minute = packed >> 32;
+            if (slot_minute > minute) {
+                return;  // Older than the ring
+            }
+            uint64_t next = slot_minute == minute
+                                ? packed + std::min<uint64_t>(hits, 0xFFFFFFFFu - (packed & 0xFFFFFFFFu))
+                                : (minute << 32) | std::min<uint64_t>(hits, 0xFFFFFFFFu);
+            if (slot.compare_exchange_weak(packed, next, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    static void atomic_min(std::atomic<int64_t>& target, int64_t value) {
+        int64_t current = target.load(std::memory_order_relaxed);
+        while (value < current &&
+               !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void atomic_max(std::atomic<int64_t>& target, int64_t value) {
+        int64_t current = target.load(std::memory_order_relaxed);
+        while (value > current &&
+               !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+inline int64_t unix_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+struct Node;
+
 struct LogCluster {
     int id;
     std::string log_template;
-    detail::TokenVector tokens;
+    // Dictionary IDs; kWildcardToken where the template has been widened
+    detail::TokenIdVector token_ids;
     folly::F14FastSet<size_t> parameter_indices;
-    std::vector<std::pair<std::string, std::string>> attributes;
+    // Written on every match, so it carries its own lock instead of the leaf's
+    folly::Synchronized<std::vector<std::pair<std::string, std::string>>> attributes;
+    // Leaf holding the cluster; null for clusters that are not in the tree.
+    // Set before the cluster is published and never changed, so it can be
+    // read without a lock (it dangles once the cluster has been evicted).
+    Node* leaf = nullptr;
+    // Cluster ID counter when the cluster was last matched. The counter only
+    // moves when a cluster is created, so it is a cheap, coarse LRU clock.
+    std::atomic<int> last_hit{0};
+    ClusterStats stats;
+
+    LogCluster(int id_, detail::TokenIdVector ids, std::string tmpl)
+        : id(id_), log_template(std::move(tmpl)), token_ids(std::move(ids))
+    {
+    }
+};
+
+struct Node {
+    // Keyed by token ID; numbers and overflow share the kWildcardToken edge
+    folly::F14FastMap<uint32_t, std::shared_ptr<Node>> children;
+    // Edge leading here (null on a shard root), so eviction can prune
+    // paths left without clusters
+    Node* parent = nullptr;
+    uint32_t key = 0;
+
+    // Guards `clusters`, `token_matrix` and the tokens/template of every
+    // cluster in it. Only meaningful on leaves; `children` is guarded by
+    // the shard lock.
+    mutable folly::SharedMutex leaf_mutex;
+    folly::small_vector<std::shared_ptr<LogCluster>, 8> clusters;
+    // Row i is clusters[i]->token_ids. Every cluster under a shard has the
+    // same token count, so rows are packed back to back for the SIMD scan.
+    std::vector<uint32_t> token_matrix;
+};
+
+/**
+ * First level of the parse tree: one independent subtree per token count.
+ * Lines of different lengths never contend, and within a shard the tree
+ * lock is only taken exclusively when a new path has to be added.
+ */
+struct LengthShard {
+    mutable folly::SharedMutex tree_mutex;
+    Node root;
+};
+
+/**
+ * Everything parse() needs from the matched cluster, copied while the
+ * leaf lock is held so callers never read a template that is being widened.
+ */
+struct ClusterMatch {
+    std::shared_ptr<LogCluster> cluster;
+    std::string log_template;
+    std::vector<size_t> parameter_indices;
+};
+
+// ============================================================================
+// FrozenDrain
+// ============================================================================
 
-    explicit LogCluster(int id_, const detail::TokenVector& tok)
-        : id(id_), tokens(tok)
+/**
+ * Immutable, inference-only copy of the parse tree, built by freeze() or
+ * mapped from a snapshot file.
+ *
+ * Nodes, edges, cluster rows and the token dictionary live in flat arrays.
+ * Each node's edges form a hash-and-displace perfect hash table, so one
+ * descent step is a seed load plus a single slot probe. Lookups take no
+ * locks and, apart from a per-thread ID buffer that only ever grows, do
+ * not allocate.
+ *
+ * Every array is plain data addressed by index, so write_snapshot() stores
+ * them as-is and open_snapshot() serves lookups straight from the mapping.
+ */
+class FrozenDrain {
+public:
+    static constexpr uint32_t kNoNode = 0xFFFFFFFFu;
+
+    FrozenDrain(const folly::F14FastMap<size_t, std::shared_ptr<LengthShard>>& shards,
+                const detail::TokenDictionary& dictionary,
+                int depth,
+                double similarity_threshold,
+                int max_children,
+                const std::atomic<int>& cluster_id_counter,
+                std::shared_ptr<const detail::RegexCache::PatternList> patterns)
+        : depth_(depth),
+          max_children_(max_children),
+          similarity_threshold_(similarity_threshold),
+          patterns_(std::move(patterns)),
+          owned_(std::make_unique<Storage>())
     {
-        update_template();
+        size_t max_width = 0;
+        for (const auto& entry : shards) {
+            max_width = std::max(max_width, entry.first);
+        }
+        owned_->shard_roots.assign(max_width + 1, kNoNode);
+        owned_->param_offsets.push_back(0);
+        for (const auto& [width, shard] : shards) {
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            owned_->shard_roots[width] = compile_node(shard->root);
+        }
+        // Taken after the tree so every ID on an edge or in a row is present,
+        // and every compiled cluster ID is below the saved counter
+        build_token_table(dictionary.entries());
+        next_cluster_id_ = cluster_id_counter.load();
+        publish(*owned_);
     }
 
-    void update_template() {
-        log_template.clear();
-        for (size_t i = 0; i < tokens.size(); ++i) {
-            if (i > 0) log_template.push_back(' ');
-            log_template.append(tokens[i].data(), tokens[i].size());
+    /**
+     * Map a snapshot written by write_snapshot(). Returns null (and logs)
+     * if the file cannot be mapped or fails validation.
+     */
+    static std::unique_ptr<FrozenDrain> open_snapshot(
+        const std::string& path,
+        std::shared_ptr<const detail::RegexCache::PatternList> patterns)
+    {
+        auto mapping = std::make_unique<MemoryMappedFile>();
+        if (!mapping->open(path)) {
+            spdlog::error("Cannot map DRAIN snapshot: {}", path);
+            return nullptr;
+        }
+        const char* base = mapping->data();
+        const size_t size = mapping->size();
+
+        SnapshotHeader header;
+        if (size < sizeof(header)) {
+            spdlog::error("DRAIN snapshot is truncated: {}", path);
+            return nullptr;
+        }
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+            header.header_size != sizeof(header)) {
+            spdlog::error("Not a DRAIN snapshot: {}", path);
+            return nullptr;
         }
+        if (header.version != kSnapshotVersion) {
+            spdlog::error("Unsupported DRAIN snapshot version {} in {}", header.version, path);
+            return nullptr;
+        }
+
+        std::unique_ptr<FrozenDrain> frozen(new FrozenDrain(header, std::move(patterns)));
+        bool mapped = true;
+        for_each_section(*frozen, [&](Section section, auto& view) {
+            mapped = mapped && map_section(base, size, header.sections[section], view);
+        });
+        if (!mapped || !frozen->validate()) {
+            spdlog::error("DRAIN snapshot is corrupt: {}", path);
+            return nullptr;
+        }
+        frozen->mapping_ = std::move(mapping);
+        return frozen;
     }
-};
 
-struct Node {
-    folly::F14FastMap<std::string, std::shared_ptr<Node>> children;
-    folly::small_vector<std::shared_ptr<LogCluster>, 8> clusters;
+    /**
+     * Write the arrays to `path` via a temporary file and rename, so a
+     * process mapping the old snapshot never sees a partial one.
+     */
+    bool write_snapshot(const std::string& path) const {
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.header_size = sizeof(header);
+        header.depth = depth_;
+        header.max_children = max_children_;
+        header.similarity_threshold = similarity_threshold_;
+        header.next_cluster_id = next_cluster_id_;
+
+        uint64_t offset = align_section(sizeof(header));
+        for_each_section(*this, [&](Section section, const auto& view) {
+            header.sections[section] = {offset, view.size()};
+            offset = align_section(offset + view.size() * sizeof(*view.begin()));
+        });
+
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                spdlog::error("Cannot write DRAIN snapshot: {}", tmp_path);
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            uint64_t written = sizeof(header);
+            for_each_section(*this, [&](Section section, const auto& view) {
+                static const char kPadding[kSectionAlignment] = {};
+                out.write(kPadding, header.sections[section].offset - written);
+                const size_t bytes = view.size() * sizeof(*view.begin());
+                out.write(reinterpret_cast<const char*>(view.begin()), bytes);
+                written = header.sections[section].offset + bytes;
+            });
+            if (!out.flush()) {
+                spdlog::error("Failed writing DRAIN snapshot: {}", tmp_path);
+                return false;
+            }
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            spdlog::error("Cannot move DRAIN snapshot into place: {}", path);
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Same result as the live tree's lookup at freeze time, or -1.
+     */
+    int cluster_id_for(std::string_view line) const {
+        const std::string_view content = detail::preprocess_log(line, patterns_.get());
+        if (content.empty()) {
+            return -1;
+        }
+        const size_t width = std::count(content.begin(), content.end(), ' ') + 1;
+        if (width >= shard_roots_.size() || shard_roots_[width] == kNoNode) {
+            return -1;
+        }
+
+        thread_local std::vector<uint32_t> ids;
+        ids.resize(width);
+        encode(content, ids.data());
+
+        uint32_t node_index = shard_roots_[width];
+        const size_t max_depth = leaf_depth(width);
+        for (size_t depth = 0; depth < max_depth; ++depth) {
+            const uint32_t token_key = detail::is_number_token(ids[depth]) ? detail::kWildcardToken
+                                                                           : ids[depth];
+            uint32_t child = find_child(nodes_[node_index], token_key);
+            if (child == kNoNode) {
+                child = find_child(nodes_[node_index], detail::kWildcardToken);
+                if (child == kNoNode) {
+                    return -1;
+                }
+            }
+            node_index = child;
+        }
+
+        // Same rule as best_cluster(): first row with the highest similarity
+        // at or above the threshold
+        const FrozenNode& leaf = nodes_[node_index];
+        const uint32_t* row = matrix_.begin() + leaf.matrix_begin;
+        double max_similarity = -1.0;
+        int cluster_id = -1;
+        for (uint32_t i = 0; i < leaf.cluster_count; ++i, row += width) {
+            double sim = double(detail::count_token_matches(row, ids.data(), width)) / double(width);
+            if (sim > max_similarity && sim >= similarity_threshold_) {
+                max_similarity = sim;
+                cluster_id = cluster_ids_[leaf.cluster_begin + i];
+            }
+        }
+        return cluster_id;
+    }
+
+    /**
+     * Bytes held by the arrays, or by the mapping for a mapped snapshot.
+     */
+    size_t bytes() const {
+        if (mapping_) {
+            return mapping_->size();
+        }
+        size_t total = 0;
+        for_each_section(*this, [&](Section, const auto& view) {
+            total += view.size() * sizeof(*view.begin());
+        });
+        return total;
+    }
+
+    int depth() const { return depth_; }
+    int max_children() const { return max_children_; }
+    double similarity_threshold() const { return similarity_threshold_; }
+    int next_cluster_id() const { return next_cluster_id_; }
+
+    /**
+     * Every (token, ID) pair in the token table. Views point into this
+     * matcher's storage.
+     */
+    std::vector<std::pair<std::string_view, uint32_t>> tokens() const {
+        std::vector<std::pair<std::string_view, uint32_t>> entries;
+        for (const TokenSlot& slot : token_slots_) {
+            if (slot.id != detail::kWildcardToken) {
+                entries.emplace_back(token_text(slot), slot.id);
+            }
+        }
+        return entries;
+    }
+
+    /**
+     * Rebuild a live tree with the same shape. `make_cluster(id, ids, params)`
+     * creates the cluster for each row, where `params` are its sorted
+     * parameter positions.
+     */
+    template <typename MakeCluster>
+    void restore_tree(folly::F14FastMap<size_t, std::shared_ptr<LengthShard>>& shards,
+                      MakeCluster&& make_cluster) const
+    {
+        for (size_t width = 0; width < shard_roots_.size(); ++width) {
+            if (shard_roots_[width] == kNoNode) {
+                continue;
+            }
+            auto shard = std::make_shared<LengthShard>();
+            restore_node(shard_roots_[width], shard->root, width, 0, make_cluster);
+            shards[width] = std::move(shard);
+        }
+    }
+
+private:
+    // Carries the number bit, which edge keys never do
+    static constexpr uint32_t kNoEdge = 0xFFFFFFFFu;
+    static constexpr char kSnapshotMagic[8] = {'L', 'O', 'G', 'A', 'I', 'D', 'R', 'N'};
+    static constexpr uint32_t kSnapshotVersion = 2;
+    static constexpr uint64_t kSectionAlignment = 8;
+
+    struct FrozenNode {
+        uint32_t slot_begin = 0;    // into edges_
+        uint32_t slot_mask = 0;
+        uint32_t seed_begin = 0;    // into seeds_
+        uint32_t bucket_mask = 0;
+        uint32_t edge_count = 0;
+        uint32_t cluster_begin = 0; // into cluster_ids_
+        uint32_t cluster_count = 0;
+        uint32_t matrix_begin = 0;  // into matrix_
+    };
+
+    struct FrozenEdge {
+        uint32_t key = kNoEdge;
+        uint32_t child = kNoNode;
+    };
+
+    struct TokenSlot {
+        uint32_t offset = 0;       // into strings_
+        uint32_t length = 0;
+        uint32_t id = detail::kWildcardToken;  // Wildcard marks an empty slot
+    };
+
+    enum Section : uint32_t {
+        kShardRoots,
+        kNodes,
+        kEdges,
+        kSeeds,
+        kClusterIds,
+        kMatrix,
+        kTokenSlots,
+        kStrings,
+        kParamOffsets,
+        kParamIndices,
+        kSectionCount
+    };
+
+    struct SnapshotSection {
+        uint64_t offset;
+        uint64_t count;  // elements, not bytes
+    };
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        int32_t depth;
+        int32_t max_children;
+        double similarity_threshold;
+        int32_t next_cluster_id;
+        uint32_t reserved;
+        SnapshotSection sections[kSectionCount];
+    };
+
+    static_assert(std::is_trivially_copyable<FrozenNode>::value &&
+                  std::is_trivially_copyable<FrozenEdge>::value &&
+                  std::is_trivially_copyable<TokenSlot>::value &&
+                  std::is_trivially_copyable<SnapshotHeader>::value,
+                  "snapshot sections are written and mapped byte for byte");
+
+    template <typename T>
+    using View = folly::Range<const T*>;
+
+    // Backing arrays for a matcher compiled in memory
+    struct Storage {
+        std::vector<uint32_t> shard_roots;  // Indexed by token count; kNoNode where no shard exists
+        std::vector<FrozenNode> nodes;
+        std::vector<FrozenEdge> edges;
+        std::vector<uint32_t> seeds;
+        std::vector<int32_t> cluster_ids;
+        // Leaf rows, each leaf's block packed back to back like Node::token_matrix
+        std::vector<uint32_t> matrix;
+        std::vector<TokenSlot> token_slots;
+        std::vector<char> strings;
+        // Cluster i's parameter positions are param_indices[param_offsets[i], param_offsets[i + 1])
+        std::vector<uint32_t> param_offsets;
+        std::vector<uint32_t> param_indices;
+    };
+
+    FrozenDrain(const SnapshotHeader& header,
+                std::shared_ptr<const detail::RegexCache::PatternList> patterns)
+        : depth_(header.depth),
+          max_children_(header.max_children),
+          similarity_threshold_(header.similarity_threshold),
+          next_cluster_id_(header.next_cluster_id),
+          patterns_(std::move(patterns))
+    {
+    }
+
+    // The one place that lists the sections, in file order
+    template <typename Self, typename Fn>
+    static void for_each_section(Self& self, Fn&& fn) {
+        fn(kShardRoots, self.shard_roots_);
+        fn(kNodes, self.nodes_);
+        fn(kEdges, self.edges_);
+        fn(kSeeds, self.seeds_);
+        fn(kClusterIds, self.cluster_ids_);
+        fn(kMatrix, self.matrix_);
+        fn(kTokenSlots, self.token_slots_);
+        fn(kStrings, self.strings_);
+        fn(kParamOffsets, self.param_offsets_);
+        fn(kParamIndices, self.param_indices_);
+    }
+
+    void publish(const Storage& storage) {
+        shard_roots_ = View<uint32_t>(storage.shard_roots.data(), storage.shard_roots.size());
+        nodes_ = View<FrozenNode>(storage.nodes.data(), storage.nodes.size());
+        edges_ = View<FrozenEdge>(storage.edges.data(), storage.edges.size());
+        seeds_ = View<uint32_t>(storage.seeds.data(), storage.seeds.size());
+        cluster_ids_ = View<int32_t>(storage.cluster_ids.data(), storage.cluster_ids.size());
+        matrix_ = View<uint32_t>(storage.matrix.data(), storage.matrix.size());
+        token_slots_ = View<TokenSlot>(storage.token_slots.data(), storage.token_slots.size());
+        strings_ = View<char>(storage.strings.data(), storage.strings.size());
+        param_offsets_ = View<uint32_t>(storage.param_offsets.data(), storage.param_offsets.size());
+        param_indices_ = View<uint32_t>(storage.param_indices.data(), storage.param_indices.size());
+    }
+
+    static uint64_t align_section(uint64_t offset) {
+        return (offset + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+    }
+
+    template <typename T>
+    static bool map_section(const char* base, size_t size, const SnapshotSection& section, View<T>& view) {
+        if (section.offset % alignof(T) != 0 || section.offset > size ||
+            section.count > (size - section.offset) / sizeof(T)) {
+            return false;
+        }
+        view = View<T>(reinterpret_cast<const T*>(base + section.offset), section.count);
+        return true;
+    }
+
+    /**
+     * Bounds-check every index a lookup or restore_tree() can follow, so a
+     * damaged file is rejected up front instead of read out of bounds.
+     */
+    bool validate() const {
+        if (token_slots_.empty() || !is_mask(token_slots_.size() - 1) ||
+            param_offsets_.size() != cluster_ids_.size() + 1 || param_offsets_[0] != 0) {
+            return false;
+        }
+        bool has_empty_slot = false;
+        for (const TokenSlot& slot : token_slots_) {
+            has_empty_slot = has_empty_slot || slot.id == detail::kWildcardToken;
+            if (slot.offset > strings_.size() || slot.length > strings_.size() - slot.offset) {
+                return false;
+            }
+        }
+        // A full table would make a miss probe forever
+        if (!has_empty_slot) {
+            return false;
+        }
+        for (size_t i = 0; i + 1 < param_offsets_.size(); ++i) {
+            if (param_offsets_[i] > param_offsets_[i + 1]) {
+                return false;
+            }
+        }
+        if (param_offsets_.back() > param_indices_.size()) {
+            return false;
+        }
+        for (const FrozenNode& node : nodes_) {
+            if (node.cluster_begin > cluster_ids_.size() ||
+                node.cluster_count > cluster_ids_.size() - node.cluster_begin) {
+                return false;
+            }
+            if (node.edge_count == 0) {
+                continue;
+            }
+            if (!is_mask(node.slot_mask) || !is_mask(node.bucket_mask) ||
+                node.slot_begin > edges_.size() || node.slot_mask >= edges_.size() - node.slot_begin ||
+                node.seed_begin > seeds_.size() || node.bucket_mask >= seeds_.size() - node.seed_begin) {
+                return false;
+            }
+        }
+        for (const FrozenEdge& edge : edges_) {
+            if (edge.key != kNoEdge && edge.child >= nodes_.size()) {
+                return false;
+            }
+        }
+        for (size_t width = 0; width < shard_roots_.size(); ++width) {
+            if (shard_roots_[width] == kNoNode) {
+                continue;
+            }
+            if (width == 0 || shard_roots_[width] >= nodes_.size() ||
+                !validate_rows(shard_roots_[width], width, 0)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool validate_rows(uint32_t node_index, size_t width, size_t depth) const {
+        const FrozenNode& node = nodes_[node_index];
+        if (node.matrix_begin > matrix_.size() ||
+            uint64_t(node.cluster_count) * width > matrix_.size() - node.matrix_begin) {
+            return false;
+        }
+        if (depth == leaf_depth(width) || node.edge_count == 0) {
+            return true;
+        }
+        for (uint32_t slot = 0; slot <= node.slot_mask; ++slot) {
+            const FrozenEdge& edge = edges_[node.slot_begin + slot];
+            if (edge.key != kNoEdge && !validate_rows(edge.child, width, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool is_mask(uint64_t mask) {
+        return (mask & (mask + 1)) == 0;
+    }
+
+    size_t leaf_depth(size_t width) const {
+        return std::min(static_cast<size_t>(std::max(depth_, 0)), width);
+    }
+
+    template <typename MakeCluster>
+    void restore_node(uint32_t node_index, Node& node, size_t width, size_t depth,
+                      MakeCluster& make_cluster) const
+    {
+        const FrozenNode& frozen = nodes_[node_index];
+        const uint32_t* row = matrix_.begin() + frozen.matrix_begin;
+        for (uint32_t i = 0; i < frozen.cluster_count; ++i, row += width) {
+            const uint32_t cluster = frozen.cluster_begin + i;
+            View<uint32_t> params(param_indices_.begin() + param_offsets_[cluster],
+                                  param_indices_.begin() + param_offsets_[cluster + 1]);
+            node.clusters.push_back(make_cluster(cluster_ids_[cluster],
+                                                 detail::TokenIdVector(row, row + width),
+                                                 params));
+            node.clusters.back()->leaf = &node;
+            node.token_matrix.insert(node.token_matrix.end(), row, row + width);
+        }
+        // Nodes are only ever created down to the leaf depth, which also
+        // bounds the walk if a damaged file links back up the tree
+        if (depth == leaf_depth(width) || frozen.edge_count == 0) {
+            return;
+        }
+        for (uint32_t slot = 0; slot <= frozen.slot_mask; ++slot) {
+            const FrozenEdge& edge = edges_[frozen.slot_begin + slot];
+            if (edge.key == kNoEdge) {
+                continue;
+            }
+            auto child = std::make_shared<Node>();
+            child->parent = &node;
+            child->key = edge.key;
+            restore_node(edge.child, *child, width, depth + 1, make_cluster);
+            node.children[edge.key] = std::move(child);
+        }
+    }
+
+    static uint32_t next_pow2(size_t n) {
+        uint32_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    // murmur3 finalizer
+    static uint32_t mix(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x85ebca6bu;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35u;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // FNV-1a: the token table is laid out by this hash and written into the
+    // snapshot, so unlike std::hash it must not differ between builds
+    static uint64_t token_hash(std::string_view token) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (char c : token) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static uint32_t slot_for(uint32_t key, uint32_t seed, uint32_t mask) {
+        return mix(key ^ (0x9E3779B9u * (seed + 1))) & mask;
+    }
+
+    uint32_t find_child(const FrozenNode& node, uint32_t key) const {
+        if (node.edge_count == 0) {
+            return kNoNode;
+        }
+        const uint32_t seed = seeds_[node.seed_begin + (mix(key) & node.bucket_mask)];
+        const FrozenEdge& edge = edges_[node.slot_begin + slot_for(key, seed, node.slot_mask)];
+        return edge.key == key ? edge.child : kNoNode;
+    }
+
+    uint32_t compile_node(const Node& node) {
+        Storage& storage = *owned_;
+        const uint32_t index = static_cast<uint32_t>(storage.nodes.size());
+        storage.nodes.emplace_back();
+        {
+            std::shared_lock<folly::SharedMutex> leaf_read(node.leaf_mutex);
+            FrozenNode& frozen = storage.nodes[index];
+            frozen.cluster_begin = static_cast<uint32_t>(storage.cluster_ids.size());
+            frozen.cluster_count = static_cast<uint32_t>(node.clusters.size());
+            frozen.matrix_begin = static_cast<uint32_t>(storage.matrix.size());
+            for (const auto& cluster : node.clusters) {
+                storage.cluster_ids.push_back(cluster->id);
+                const size_t params_begin = storage.param_indices.size();
+                storage.param_indices.insert(storage.param_indices.end(),
+                                             cluster->parameter_indices.begin(),
+                                             cluster->parameter_indices.end());
+                std::sort(storage.param_indices.begin() + params_begin, storage.param_indices.end());
+                storage.param_offsets.push_back(static_cast<uint32_t>(storage.param_indices.size()));
+            }
+            storage.matrix.insert(storage.matrix.end(), node.token_matrix.begin(), node.token_matrix.end());
+        }
+        if (node.children.empty()) {
+            return index;
+        }
+
+        std::vector<FrozenEdge> edges;
+        edges.reserve(node.children.size());
+        for (const auto& [key, child] : node.children) {
+            edges.push_back({key, compile_node(*child)});
+        }
+        place_edges(index, edges);
+        return index;
+    }
+
+    /**
+     * Hash-and-displace construction: keys are bucketed by one hash, and
+     * each bucket (largest first) gets the first seed that drops all of its
+     * keys into free slots of a table twice the bucket count.
+     */
+    void place_edges(uint32_t index, const std::vector<FrozenEdge>& edges) {
+        Storage& storage = *owned_;
+        const uint32_t bucket_count = next_pow2(edges.size());
+        const uint32_t slot_count = bucket_count * 2;
+
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (uint32_t i = 0; i < edges.size(); ++i) {
+            buckets[mix(edges[i].key) & (bucket_count - 1)].push_back(i);
+        }
+        std::vector<uint32_t> order(bucket_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<FrozenEdge> table(slot_count);
+        std::vector<uint32_t> seeds(bucket_count, 0);
+        std::vector<uint32_t> placed;
+        for (uint32_t bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            for (uint32_t seed = 0;; ++seed) {
+                placed.clear();
+                for (uint32_t edge : buckets[bucket]) {
+                    const uint32_t slot = slot_for(edges[edge].key, seed, slot_count - 1);
+                    if (table[slot].key != kNoEdge ||
+                        std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                        break;
+                    }
+                    placed.push_back(slot);
+                }
+                if (placed.size() == buckets[bucket].size()) {
+                    for (size_t k = 0; k < placed.size(); ++k) {
+                        table[placed[k]] = edges[buckets[bucket][k]];
+                    }
+                    seeds[bucket] = seed;
+                    break;
+                }
+            }
+        }
+
+        FrozenNode& frozen = storage.nodes[index];
+        frozen.edge_count = static_cast<uint32_t>(edges.size());
+        frozen.slot_begin = static_cast<uint32_t>(storage.edges.size());
+        frozen.slot_mask = slot_count - 1;
+        frozen.seed_begin = static_cast<uint32_t>(storage.seeds.size());
+        frozen.bucket_mask = bucket_count - 1;
+        storage.edges.insert(storage.edges.end(), table.begin(), table.end());
+        storage.seeds.insert(storage.seeds.end(), seeds.begin(), seeds.end());
+    }
+
+    void build_token_table(const std::vector<std::pair<std::string_view, uint32_t>>& tokens) {
+        Storage& storage = *owned_;
+        // At most half full so probe sequences stay short
+        storage.token_slots.resize(next_pow2(tokens.size() * 2 + 1));
+        const size_t mask = storage.token_slots.size() - 1;
+        for (const auto& [text, id] : tokens) {
+            size_t slot = token_hash(text) & mask;
+            while (storage.token_slots[slot].id != detail::kWildcardToken) {
+                slot = (slot + 1) & mask;
+            }
+            storage.token_slots[slot] = {static_cast<uint32_t>(storage.strings.size()),
+                                         static_cast<uint32_t>(text.size()), id};
+            storage.strings.insert(storage.strings.end(), text.begin(), text.end());
+        }
+    }
+
+    std::string_view token_text(const TokenSlot& slot) const {
+        return std::string_view(strings_.begin() + slot.offset, slot.length);
+    }
+
+    uint32_t token_id(std::string_view token) const {
+        const size_t mask = token_slots_.size() - 1;
+        size_t slot = token_hash(token) & mask;
+        while (token_slots_[slot].id != detail::kWildcardToken) {
+            if (token_text(token_slots_[slot]) == token) {
+                return token_slots_[slot].id;
+            }
+            slot = (slot + 1) & mask;
+        }
+        return detail::is_number(token) ? (detail::kUnknownToken | detail::kNumberTokenBit)
+                                        : detail::kUnknownToken;
+    }
+
+    // Split on single spaces exactly like detail::tokenize, straight into IDs
+    void encode(std::string_view content, uint32_t* ids) const {
+        size_t start = 0;
+        for (size_t i = 0;; ++i) {
+            size_t end = content.find(' ', start);
+            if (end == std::string_view::npos) {
+                ids[i] = token_id(content.substr(start));
+                return;
+            }
+            ids[i] = token_id(content.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+    int depth_;
+    int max_children_;
+    double similarity_threshold_;
+    int next_cluster_id_ = 0;
+    // Preprocess patterns captured at freeze time; null for the built-ins
+    std::shared_ptr<const detail::RegexCache::PatternList> patterns_;
+
+    // Exactly one of these backs the views below
+    std::unique_ptr<Storage> owned_;
+    std::unique_ptr<MemoryMappedFile> mapping_;
+
+    View<uint32_t> shard_roots_;
+    View<FrozenNode> nodes_;
+    View<FrozenEdge> edges_;
+    View<uint32_t> seeds_;
+    View<int32_t> cluster_ids_;
+    View<uint32_t> matrix_;
+    View<TokenSlot> token_slots_;
+    View<char> strings_;
+    View<uint32_t> param_offsets_;
+    View<uint32_t> param_indices_;
 };
 
 // ============================================================================
@@ -170,18 +1266,19 @@ public:
         int depth;
         double similarity_threshold;
         int max_children;
+        size_t max_clusters;  // 0 = unbounded
     };
 
 public:
-    DrainParserImpl(int depth, double similarity_threshold, int max_children)
-        : root_(std::make_shared<Node>()),
-          cluster_id_counter_(0)
+    DrainParserImpl(int depth, double similarity_threshold, int max_children, size_t max_clusters)
+        : cluster_id_counter_(0)
     {
         // Initialize our internal DRAIN config
         auto conf = drain_config_.wlock();
         conf->depth = depth;
         conf->similarity_threshold = similarity_threshold;
         conf->max_children = max_children;
+        conf->max_clusters = max_clusters;
     }
 
     LogRecordObject parse(std::string_view line, const DataLoaderConfig& user_cfg) {
@@ -193,13 +1290,14 @@ public:
         auto tokens = detail::tokenize(content);
 
         // Match or create a cluster
-        auto matched_cluster = match_log_message(tokens);
+        auto match = match_log_message(tokens);
+        match.cluster->stats.record(1, unix_time_ms());
 
-        record.template_str = matched_cluster->log_template;
-        record.fields["cluster_id"] = std::to_string(matched_cluster->id);
+        record.template_str = std::move(match.log_template);
+        record.fields["cluster_id"] = std::to_string(match.cluster->id);
 
         // Extract attributes from the log line
-        extract_attributes(tokens, matched_cluster->parameter_indices, matched_cluster->attributes);
+        extract_attributes(tokens, match.parameter_indices, match.cluster->attributes);
 
         // Possibly extract more metadata from line or user_cfg
         extract_metadata(line, record, user_cfg);
@@ -207,10 +1305,164 @@ public:
     }
 
     int get_cluster_id_for_log(std::string_view line) const {
+        if (auto frozen = std::atomic_load(&frozen_)) {
+            return frozen->cluster_id_for(line);
+        }
         std::string_view content = detail::preprocess_log(line);
         auto tokens = detail::tokenize(content);
-        auto matched_cluster = find_matching_cluster(tokens);
-        return matched_cluster->id;
+        return find_matching_cluster_id(tokens);
+    }
+
+    void freeze() {
+        publish_frozen(compile());
+    }
+
+    bool save_snapshot(const std::string& path) const {
+        return compile()->write_snapshot(path);
+    }
+
+    bool load_snapshot(const std::string& path) {
+        auto frozen = FrozenDrain::open_snapshot(path, detail::RegexCache::instance().get_custom_patterns());
+        if (!frozen) {
+            return false;
+        }
+        if (cluster_id_counter_.load() != 0 || !dictionary_.restore(frozen->tokens())) {
+            spdlog::error("DRAIN snapshot can only be loaded before anything is parsed: {}", path);
+            return false;
+        }
+
+        // The tree's shape depends on these, so they come from the snapshot
+        {
+            auto conf = drain_config_.wlock();
+            conf->depth = frozen->depth();
+            conf->similarity_threshold = frozen->similarity_threshold();
+            conf->max_children = frozen->max_children();
+        }
+        {
+            auto shards = shards_.wlock();
+            auto clusters = clusters_.wlock();
+            auto tmpl_map = templates_.wlock();
+            frozen->restore_tree(*shards, [&](int id, detail::TokenIdVector ids,
+                                              folly::Range<const uint32_t*> params) {
+                auto cluster = std::make_shared<LogCluster>(id, std::move(ids), std::string());
+                cluster->log_template = render_template(cluster->token_ids);
+                cluster->parameter_indices.insert(params.begin(), params.end());
+                clusters->emplace(id, cluster);
+                (*tmpl_map)[id] = cluster->log_template;
+                return cluster;
+            });
+            tree_cluster_count_.store(clusters->size(), std::memory_order_relaxed);
+        }
+        cluster_id_counter_.store(frozen->next_cluster_id());
+
+        // Lookups are served from the mapping right away
+        publish_frozen(std::move(frozen));
+        return true;
+    }
+
+    folly::F14FastMap<int, int> merge(const DrainParserImpl& other) {
+        folly::F14FastMap<int, int> remap;
+        std::vector<std::shared_ptr<LogCluster>> incoming;
+        {
+            auto clusters = other.clusters_.rlock();
+            incoming.reserve(clusters->size());
+            for (const auto& entry : *clusters) {
+                incoming.push_back(entry.second);
+            }
+        }
+        if (&other == this) {
+            for (const auto& cluster : incoming) {
+                remap.emplace(cluster->id, cluster->id);
+            }
+            return remap;
+        }
+        // ID order makes the outcome depend only on the two states, not on
+        // hash-map iteration order
+        std::sort(incoming.begin(), incoming.end(), [](const auto& a, const auto& b) {
+            return a->id < b->id;
+        });
+
+        const DrainConfig drain_conf = drain_config_.copy();
+        std::shared_lock<folly::SharedMutex> ids_read(ids_mutex_);
+        for (const auto& cluster : incoming) {
+            if (cluster->token_ids.empty()) {
+                const auto& empty = empty_cluster();
+                empty->stats.absorb(cluster->stats);
+                remap.emplace(cluster->id, empty->id);
+                continue;
+            }
+
+            // Re-key the template into this parser's dictionary; wildcards
+            // stay wildcards so they widen whatever they land on
+            detail::TokenIdVector ids;
+            ids.reserve(cluster->token_ids.size());
+            for (uint32_t id : cluster->token_ids) {
+                ids.push_back(id == detail::kWildcardToken
+                                  ? detail::kWildcardToken
+                                  : dictionary_.intern(other.dictionary_.text(id)));
+            }
+
+            auto shard = get_or_create_shard(ids.size());
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            Node* leaf = descend(shard->root, ids, drain_conf, /*create=*/false);
+            if (!leaf) {
+                leaf = add_path(*shard, tree_read, ids, drain_conf);
+            }
+            std::unique_lock<folly::SharedMutex> leaf_write(leaf->leaf_mutex);
+            auto target = best_cluster(*leaf, ids, drain_conf.similarity_threshold);
+            if (!target) {
+                target = add_cluster(*leaf, ids);
+            } else {
+                update_template(*leaf, target, ids);
+            }
+            target->parameter_indices.insert(cluster->parameter_indices.begin(),
+                                             cluster->parameter_indices.end());
+            target->stats.absorb(cluster->stats);
+            remap.emplace(cluster->id, target->id);
+        }
+        return remap;
+    }
+
+    std::vector<DrainClusterStats> get_all_cluster_stats(size_t minutes) const {
+        std::vector<std::shared_ptr<LogCluster>> clusters;
+        {
+            auto cluster_map = clusters_.rlock();
+            clusters.reserve(cluster_map->size());
+            for (const auto& entry : *cluster_map) {
+                clusters.push_back(entry.second);
+            }
+        }
+        const int64_t now_ms = unix_time_ms();
+        std::vector<DrainClusterStats> stats;
+        stats.reserve(clusters.size());
+        for (const auto& cluster : clusters) {
+            stats.push_back(stats_for(*cluster, minutes, now_ms));
+        }
+        std::sort(stats.begin(), stats.end(), [](const auto& a, const auto& b) {
+            return a.cluster_id < b.cluster_id;
+        });
+        return stats;
+    }
+
+    std::optional<DrainClusterStats> get_cluster_stats(int cluster_id, size_t minutes) const {
+        std::shared_ptr<LogCluster> cluster;
+        {
+            auto clusters = clusters_.rlock();
+            auto it = clusters->find(cluster_id);
+            if (it == clusters->end()) {
+                return std::nullopt;
+            }
+            cluster = it->second;
+        }
+        return stats_for(*cluster, minutes, unix_time_ms());
+    }
+
+    void thaw() {
+        std::atomic_store(&frozen_, std::shared_ptr<const FrozenDrain>());
+    }
+
+    bool is_frozen() const {
+        return std::atomic_load(&frozen_) != nullptr;
     }
 
     std::optional<int> get_cluster_id_from_record(const LogRecordObject& record) const {
@@ -222,17 +1474,76 @@ public:
                 spdlog::error("Error converting cluster_id: {}", e.what());
             }
         }
-        return std::nullopt;
-    }
+        return std::nullopt;
+    }
+
+    void set_depth(int depth) {
+        auto conf = drain_config_.wlock();
+        conf->depth = depth;
+    }
+
+    void set_similarity_threshold(double threshold) {
+        auto conf = drain_config_.wlock();
+        conf->similarity_threshold = threshold;
+    }
+
+    void set_max_clusters(size_t max_clusters) {
+        DrainConfig drain_conf;
+        {
+            auto conf = drain_config_.wlock();
+            conf->max_clusters = max_clusters;
+            drain_conf = *conf;
+        }
+        evict_if_needed(drain_conf);
+    }
+
+    void enforce_max_clusters() {
+        evict_if_needed(drain_config_.copy());
+    }
+
+    DrainMemoryUsage memory_usage() const {
+        DrainMemoryUsage usage;
+
+        std::vector<std::shared_ptr<LengthShard>> shards;
+        {
+            auto shard_map = shards_.rlock();
+            for (const auto& entry : *shard_map) {
+                shards.push_back(entry.second);
+            }
+        }
+        for (const auto& shard : shards) {
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            usage.tree_bytes += sizeof(LengthShard);
+            node_bytes(shard->root, usage);
+        }
 
-    void set_depth(int depth) {
-        auto conf = drain_config_.wlock();
-        conf->depth = depth;
-    }
+        {
+            auto clusters = clusters_.rlock();
+            usage.clusters = clusters->size();
+            for (const auto& [id, cluster] : *clusters) {
+                // Tree clusters were sized under their leaf lock above; the
+                // rest are never widened
+                if (!cluster->leaf) {
+                    usage.cluster_bytes += cluster_bytes(*cluster);
+                }
+            }
+            usage.cluster_bytes += clusters->size() * (sizeof(int) + sizeof(std::shared_ptr<LogCluster>));
+        }
+        {
+            auto tmpl_map = templates_.rlock();
+            for (const auto& [id, tmpl] : *tmpl_map) {
+                usage.cluster_bytes += sizeof(id) + sizeof(tmpl) + tmpl.capacity();
+            }
+        }
 
-    void set_similarity_threshold(double threshold) {
-        auto conf = drain_config_.wlock();
-        conf->similarity_threshold = threshold;
+        usage.dictionary_tokens = dictionary_.size();
+        usage.dictionary_bytes = dictionary_.memory_bytes();
+        if (auto frozen = std::atomic_load(&frozen_)) {
+            usage.frozen_bytes = frozen->bytes();
+        }
+        usage.total_bytes = usage.tree_bytes + usage.cluster_bytes + usage.dictionary_bytes +
+                            usage.frozen_bytes;
+        return usage;
     }
 
     std::optional<std::string> get_template_for_cluster_id(int cluster_id) const {
@@ -245,12 +1556,16 @@ public:
     }
 
     std::vector<std::pair<std::string, std::string>> get_template_attributes(int cluster_id) const {
-        auto clusters = clusters_.rlock();
-        auto it = clusters->find(cluster_id);
-        if (it != clusters->end()) {
-            return it->second->attributes;
+        std::shared_ptr<LogCluster> cluster;
+        {
+            auto clusters = clusters_.rlock();
+            auto it = clusters->find(cluster_id);
+            if (it == clusters->end()) {
+                return {};
+            }
+            cluster = it->second;
         }
-        return {};
+        return cluster->attributes.copy();
     }
 
     void set_preprocess_patterns(const std::vector<std::string>& pattern_strings) {
@@ -271,209 +1586,724 @@ public:
         return *tmpl_map;
     }
 
+    void parse_batch(folly::Range<const std::string_view*> lines,
+                     DrainBatchResult& out,
+                     bool want_templates,
+                     bool want_parameters)
+    {
+        const size_t n = lines.size();
+        out.cluster_ids.assign(n, -1);
+        out.templates.clear();
+        out.parameters.clear();
+        if (want_templates) {
+            out.templates.resize(n);
+        }
+        if (want_parameters) {
+            out.parameters.resize(n);
+        }
+        if (n == 0) {
+            return;
+        }
+
+        // Config and dictionary are each locked once for the whole batch
+        const DrainConfig drain_conf = drain_config_.copy();
+
+        std::vector<detail::TokenVector> tokens(n);
+        for (size_t i = 0; i < n; ++i) {
+            tokens[i] = detail::tokenize(detail::preprocess_log(lines[i]));
+        }
+        // Token IDs stay valid until the batch is matched
+        std::shared_lock<folly::SharedMutex> ids_read(ids_mutex_);
+        std::vector<detail::TokenIdVector> ids;
+        std::vector<size_t> unknown;
+        dictionary_.encode_batch(tokens, ids, unknown);
+
+        // Group lines by token count so each shard is looked up and locked
+        // once per batch and its subtree stays hot while the group is matched
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return tokens[a].size() < tokens[b].size();
+        });
+
+        // Attributes hold the last-seen parameters, so each cluster is only
+        // written once per batch
+        folly::F14FastMap<std::shared_ptr<LogCluster>, std::pair<uint32_t, std::vector<size_t>>> last_seen;
+        // Stats are likewise bumped once per cluster per batch
+        folly::F14FastMap<std::shared_ptr<LogCluster>, uint64_t> hits;
+
+        // Parameter positions are always needed: attributes are kept up to
+        // date whether or not the caller wants the parameters themselves
+        ClusterMatch match;
+
+        size_t group_start = 0;
+        while (group_start < n) {
+            const size_t width = tokens[order[group_start]].size();
+            size_t group_end = group_start;
+            while (group_end < n && tokens[order[group_end]].size() == width) {
+                ++group_end;
+            }
+
+            if (width == 0) {
+                const auto& empty = empty_cluster();
+                hits[empty] += group_end - group_start;
+                for (size_t k = group_start; k < group_end; ++k) {
+                    const uint32_t i = order[k];
+                    out.cluster_ids[i] = empty->id;
+                    if (want_templates) {
+                        out.templates[i] = empty->log_template;
+                    }
+                }
+                group_start = group_end;
+                continue;
+            }
+
+            auto shard = get_or_create_shard(width);
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            for (size_t k = group_start; k < group_end; ++k) {
+                const uint32_t i = order[k];
+                auto cluster = match_in_shard(*shard, tree_read, tokens[i], ids[i], unknown[i],
+                                              drain_conf, &match, want_templates);
+                ++hits[cluster];
+                out.cluster_ids[i] = cluster->id;
+                if (want_templates) {
+                    out.templates[i] = std::move(match.log_template);
+                }
+                std::sort(match.parameter_indices.begin(), match.parameter_indices.end());
+                if (want_parameters) {
+                    auto& params = out.parameters[i];
+                    params.reserve(match.parameter_indices.size());
+                    for (size_t idx : match.parameter_indices) {
+                        if (idx < tokens[i].size()) {
+                            params.emplace_back(tokens[i][idx]);
+                        }
+                    }
+                }
+                last_seen[cluster] = {i, std::move(match.parameter_indices)};
+            }
+            group_start = group_end;
+        }
+        ids_read.unlock();
+
+        for (auto& [cluster, seen] : last_seen) {
+            extract_attributes(tokens[seen.first], seen.second, cluster->attributes);
+        }
+        const int64_t now_ms = unix_time_ms();
+        for (const auto& [cluster, count] : hits) {
+            cluster->stats.record(count, now_ms);
+        }
+        evict_if_needed(drain_conf);
+    }
+
+    /**
+     * parse_batch() followed by the same per-record fields parse() sets.
+     */
+    void parse_batch_records(folly::Range<const std::string_view*> lines,
+                             std::vector<LogRecordObject>& records,
+                             const DataLoaderConfig& user_cfg)
+    {
+        DrainBatchResult result;
+        parse_batch(lines, result, /*want_templates=*/true, /*want_parameters=*/true);
+
+        records.reserve(records.size() + lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            LogRecordObject record;
+            record.body = std::string(lines[i]);
+            record.template_str = std::move(result.templates[i]);
+            record.fields["cluster_id"] = std::to_string(result.cluster_ids[i]);
+            extract_metadata(lines[i], record, user_cfg);
+            records.push_back(std::move(record));
+        }
+    }
+
 private:
+    std::unique_ptr<FrozenDrain> compile() const {
+        const DrainConfig drain_conf = drain_config_.copy();
+        const auto shards = shards_.copy();
+        std::shared_lock<folly::SharedMutex> ids_read(ids_mutex_);
+        return std::make_unique<FrozenDrain>(
+            shards, dictionary_, drain_conf.depth, drain_conf.similarity_threshold,
+            drain_conf.max_children, cluster_id_counter_,
+            detail::RegexCache::instance().get_custom_patterns());
+    }
+
+    void publish_frozen(std::shared_ptr<const FrozenDrain> frozen) {
+        std::atomic_store(&frozen_, std::move(frozen));
+    }
+
     /**
      * Match or create a LogCluster for the tokenized log line.
+     *
+     * The common case (an existing cluster matches and its template already
+     * covers the line) only takes shared locks. The shard lock is taken
+     * exclusively to add a new tree path, and the leaf lock to create a
+     * cluster or widen a template.
      */
-    std::shared_ptr<LogCluster> match_log_message(const detail::TokenVector& tokens) {
+    ClusterMatch match_log_message(const detail::TokenVector& tokens) {
         // If empty, treat as a special cluster
         if (tokens.empty()) {
-            auto empty_cluster = std::make_shared<LogCluster>(
-                cluster_id_counter_.fetch_add(1),
-                detail::TokenVector{std::string_view("<EMPTY>")}
-            );
-            auto lock_t = templates_.wlock();
-            (*lock_t)[empty_cluster->id] = empty_cluster->log_template;
-            return empty_cluster;
-        }
-
-        // Lock for writing the root
-        auto root_lock = root_.wlock();
-        auto drain_conf = drain_config_.rlock();
-
-        // 1) Match by token count at top level
-        auto current_node = *root_lock;
-        std::string length_key = std::to_string(tokens.size());
-
-        auto iter = current_node->children.find(length_key);
-        if (iter == current_node->children.end()) {
-            // Create child node
-            auto new_node = std::make_shared<Node>();
-            current_node->children[length_key] = new_node;
-            current_node = new_node;
-        } else {
-            current_node = iter->second;
+            const auto& empty = empty_cluster();
+            return {empty, empty->log_template, {}};
         }
 
-        // 2) Descend up to drain_conf->depth
-        const int max_depth = std::min(drain_conf->depth, static_cast<int>(tokens.size()));
-        for (int depth = 0; depth < max_depth; ++depth) {
-            std::string_view token = tokens[depth];
-            std::string token_key = detail::is_number(token) ? WILDCARD
-                                                             : std::string(token);
-            auto child_iter = current_node->children.find(token_key);
-            if (child_iter == current_node->children.end()) {
-                // Possibly fallback to wildcard if children is at capacity
-                if ((int)current_node->children.size() < drain_conf->max_children) {
-                    auto new_node = std::make_shared<Node>();
-                    current_node->children[token_key] = new_node;
-                    current_node = new_node;
-                } else {
-                    // Force to wildcard
-                    token_key = WILDCARD;
-                    auto w_iter = current_node->children.find(token_key);
-                    if (w_iter == current_node->children.end()) {
-                        auto new_node = std::make_shared<Node>();
-                        current_node->children[token_key] = new_node;
-                        current_node = new_node;
-                    } else {
-                        current_node = w_iter->second;
-                    }
-                }
-            } else {
-                current_node = child_iter->second;
-            }
+        const DrainConfig drain_conf = drain_config_.copy();
+
+        ClusterMatch match;
+        {
+            std::shared_lock<folly::SharedMutex> ids_read(ids_mutex_);
+
+            // Map every token to its dictionary ID once; everything below
+            // compares IDs
+            detail::TokenIdVector ids;
+            size_t unknown = dictionary_.encode(tokens, ids);
+
+            // 1) Match by token count at top level
+            auto shard = get_or_create_shard(tokens.size());
+
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            match_in_shard(*shard, tree_read, tokens, ids, unknown, drain_conf, &match,
+                           /*with_template=*/true);
         }
+        evict_if_needed(drain_conf);
+        return match;
+    }
 
-        // 3) Among existing clusters, pick best match above threshold
-        double max_similarity = -1.0;
-        std::shared_ptr<LogCluster> matched_cluster = nullptr;
+    /**
+     * Steps 2-4 of match_log_message for a line whose shard is already
+     * known. `tree_read` must hold the shard lock shared on entry and still
+     * holds it on return. If `snapshot_out` is set it receives the
+     * cluster's parameter positions and, if `with_template`, its template,
+     * copied under the leaf lock.
+     */
+    std::shared_ptr<LogCluster> match_in_shard(LengthShard& shard,
+                                               std::shared_lock<folly::SharedMutex>& tree_read,
+                                               const detail::TokenVector& tokens,
+                                               detail::TokenIdVector& ids,
+                                               size_t unknown,
+                                               const DrainConfig& drain_conf,
+                                               ClusterMatch* snapshot_out,
+                                               bool with_template)
+    {
+        // 2) Descend up to drain_conf.depth
+        Node* leaf = descend(shard.root, ids, drain_conf, /*create=*/false);
+        if (!leaf) {
+            // New edges are keyed by real IDs
+            dictionary_.intern_unknown(tokens, ids);
+            unknown = 0;
+            leaf = add_path(shard, tree_read, ids, drain_conf);
+        }
 
-        for (auto& cluster : current_node->clusters) {
-            double sim = calculate_similarity(cluster->tokens, tokens);
-            if (sim > max_similarity && sim >= drain_conf->similarity_threshold) {
-                max_similarity = sim;
-                matched_cluster = cluster;
+        // 3) Among existing clusters, pick best match above threshold
+        {
+            std::shared_lock<folly::SharedMutex> leaf_read(leaf->leaf_mutex);
+            auto matched_cluster = best_cluster(*leaf, ids, drain_conf.similarity_threshold);
+            if (matched_cluster && !needs_widening(*matched_cluster, ids)) {
+                touch(*matched_cluster);
+                if (snapshot_out) {
+                    *snapshot_out = snapshot(matched_cluster, with_template);
+                }
+                return matched_cluster;
             }
         }
 
-        // 4) If no match, create
+        // 4) Slow path: re-check under the exclusive leaf lock since another
+        //    thread may have created or widened a cluster in the meantime
+        std::unique_lock<folly::SharedMutex> leaf_write(leaf->leaf_mutex);
+        auto matched_cluster = best_cluster(*leaf, ids, drain_conf.similarity_threshold);
         if (!matched_cluster) {
-            matched_cluster = std::make_shared<LogCluster>(cluster_id_counter_.fetch_add(1), tokens);
-            extract_parameters(tokens, matched_cluster);
-            current_node->clusters.push_back(matched_cluster);
+            // Only tokens that end up in a template are worth a dictionary entry
+            if (unknown > 0) {
+                dictionary_.intern_unknown(tokens, ids);
+            }
+            matched_cluster = add_cluster(*leaf, ids);
         } else {
             // Update the cluster's template if needed
-            update_template(matched_cluster, tokens);
+            update_template(*leaf, matched_cluster, ids);
+            touch(*matched_cluster);
+        }
+
+        if (snapshot_out) {
+            *snapshot_out = snapshot(matched_cluster, with_template);
+        }
+        return matched_cluster;
+    }
+
+    DrainClusterStats stats_for(const LogCluster& cluster, size_t minutes, int64_t now_ms) const {
+        DrainClusterStats stats;
+        stats.cluster_id = cluster.id;
+        if (auto tmpl = get_template_for_cluster_id(cluster.id)) {
+            stats.log_template = std::move(*tmpl);
+        }
+        stats.count = cluster.stats.count.load(std::memory_order_relaxed);
+        if (stats.count > 0) {
+            stats.first_seen_ms = cluster.stats.first_seen_ms.load(std::memory_order_relaxed);
+            stats.last_seen_ms = cluster.stats.last_seen_ms.load(std::memory_order_relaxed);
+        }
+        stats.per_minute.assign(std::min(minutes, ClusterStats::kMinutes), 0);
+        cluster.stats.minutes_ending_at(now_ms, stats.per_minute);
+        return stats;
+    }
+
+    static void touch(LogCluster& cluster, int now) {
+        // Skip the store when nothing changed so hot clusters don't bounce
+        // their cache line between threads
+        if (cluster.last_hit.load(std::memory_order_relaxed) != now) {
+            cluster.last_hit.store(now, std::memory_order_relaxed);
+        }
+    }
+
+    void touch(LogCluster& cluster) const {
+        touch(cluster, cluster_id_counter_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * The single cluster every empty line maps to, created on first use.
+     * It is registered like any other cluster but has no leaf, so it never
+     * counts toward max_clusters and is never evicted.
+     */
+    const std::shared_ptr<LogCluster>& empty_cluster() {
+        std::call_once(empty_cluster_once_, [this] {
+            auto cluster = std::make_shared<LogCluster>(
+                cluster_id_counter_.fetch_add(1), detail::TokenIdVector{}, "<EMPTY>");
+            clusters_.wlock()->emplace(cluster->id, cluster);
+            (*templates_.wlock())[cluster->id] = cluster->log_template;
+            empty_cluster_ = std::move(cluster);
+        });
+        return empty_cluster_;
+    }
+
+    void evict_if_needed(const DrainConfig& drain_conf) {
+        if (drain_conf.max_clusters > 0 &&
+            tree_cluster_count_.load(std::memory_order_relaxed) > drain_conf.max_clusters) {
+            evict_lru(drain_conf.max_clusters);
+        }
+    }
+
+    /**
+     * Remove the least recently matched clusters until at most
+     * `max_clusters` remain, plus ~3% headroom so the full scan is paid
+     * once per many new clusters rather than once per line. Called with no
+     * lock held (ids_mutex_ included); one thread evicts at a time and the
+     * others carry on.
+     */
+    void evict_lru(size_t max_clusters) {
+        std::unique_lock<std::mutex> evicting(eviction_mutex_, std::try_to_lock);
+        if (!evicting.owns_lock()) {
+            return;
         }
 
-        // Update the global template map
+        // Hit times are sampled once; other threads keep updating them
+        std::vector<std::pair<int, std::shared_ptr<LogCluster>>> by_age;
+        {
+            auto clusters = clusters_.rlock();
+            by_age.reserve(clusters->size());
+            for (const auto& entry : *clusters) {
+                if (entry.second->leaf) {
+                    by_age.emplace_back(entry.second->last_hit.load(std::memory_order_relaxed), entry.second);
+                }
+            }
+        }
+        if (by_age.size() <= max_clusters) {
+            return;
+        }
+        const size_t headroom = std::min(max_clusters / 32, max_clusters - 1);
+        const size_t victims = by_age.size() - (max_clusters - headroom);
+        std::nth_element(by_age.begin(), by_age.begin() + victims, by_age.end(),
+                         [](const auto& a, const auto& b) {
+                             return a.first != b.first ? a.first < b.first : a.second->id < b.second->id;
+                         });
+        std::vector<std::shared_ptr<LogCluster>> candidates;
+        candidates.reserve(victims);
+        for (size_t i = 0; i < victims; ++i) {
+            candidates.push_back(std::move(by_age[i].second));
+        }
+        // Victims are grouped by shard so each shard lock is taken once.
+        // It is taken exclusively, which also keeps every leaf lock free,
+        // so emptied paths can be pruned on the way.
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+            return a->token_ids.size() < b->token_ids.size();
+        });
+
+        size_t evicted = 0;
+        for (size_t group_start = 0; group_start < candidates.size();) {
+            const size_t width = candidates[group_start]->token_ids.size();
+            size_t group_end = group_start;
+            while (group_end < candidates.size() && candidates[group_end]->token_ids.size() == width) {
+                ++group_end;
+            }
+            auto shard = get_or_create_shard(width);
+            std::unique_lock<folly::SharedMutex> tree_write(shard->tree_mutex);
+            for (size_t k = group_start; k < group_end; ++k) {
+                const auto& cluster = candidates[k];
+                Node* leaf = cluster->leaf;
+                auto it = std::find(leaf->clusters.begin(), leaf->clusters.end(), cluster);
+                if (it == leaf->clusters.end()) {
+                    continue;
+                }
+                const size_t row = it - leaf->clusters.begin();
+                leaf->clusters.erase(it);
+                leaf->token_matrix.erase(leaf->token_matrix.begin() + row * width,
+                                         leaf->token_matrix.begin() + (row + 1) * width);
+                prune(leaf);
+                ++evicted;
+            }
+            group_start = group_end;
+        }
         {
-            auto lock_t = templates_.wlock();
-            (*lock_t)[matched_cluster->id] = matched_cluster->log_template;
+            auto clusters = clusters_.wlock();
+            auto tmpl_map = templates_.wlock();
+            for (const auto& cluster : candidates) {
+                clusters->erase(cluster->id);
+                tmpl_map->erase(cluster->id);
+            }
         }
+        tree_cluster_count_.fetch_sub(evicted, std::memory_order_relaxed);
 
-        return matched_cluster;
+        // Tokens that only evicted clusters used are still in the
+        // dictionary; rebuild it once it has doubled since the last rebuild
+        if (dictionary_.size() > compact_threshold_) {
+            compact_dictionary();
+            compact_threshold_ = std::max(kMinCompactTokens, 2 * dictionary_.size());
+        }
     }
 
     /**
-     * Find existing cluster that best matches the tokens. Does NOT create a new cluster.
+     * Rebuild the dictionary from the tokens still on tree edges and in
+     * clusters, and rewrite those IDs. Matching holds ids_mutex_ shared for
+     * as long as it keeps token IDs, so taking it exclusively here stops
+     * every parse while IDs change; shard locks keep memory_usage() out.
      */
-    std::shared_ptr<LogCluster> find_matching_cluster(const detail::TokenVector& tokens) const {
-        if (tokens.empty()) {
-            return std::make_shared<LogCluster>(-1,
-                detail::TokenVector{std::string_view("<EMPTY>")});
+    void compact_dictionary() {
+        std::unique_lock<folly::SharedMutex> ids_write(ids_mutex_);
+        const auto shards = shards_.copy();
+
+        std::vector<uint32_t> live;
+        for (const auto& [width, shard] : shards) {
+            std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+            collect_token_ids(shard->root, live);
+        }
+        const size_t before = dictionary_.size();
+        const auto remap = dictionary_.compact(live);
+        for (const auto& [width, shard] : shards) {
+            std::unique_lock<folly::SharedMutex> tree_write(shard->tree_mutex);
+            remap_token_ids(shard->root, remap);
+        }
+        spdlog::debug("DRAIN dictionary compacted from {} to {} tokens", before, dictionary_.size());
+    }
+
+    static void collect_token_ids(const Node& node, std::vector<uint32_t>& live) {
+        for (const auto& cluster : node.clusters) {
+            live.insert(live.end(), cluster->token_ids.begin(), cluster->token_ids.end());
+        }
+        for (const auto& [key, child] : node.children) {
+            live.push_back(key);
+            collect_token_ids(*child, live);
+        }
+    }
+
+    static void remap_token_ids(Node& node, const std::vector<uint32_t>& remap) {
+        auto remap_id = [&](uint32_t& id) {
+            if (id != detail::kWildcardToken) {
+                id = remap[id & ~detail::kNumberTokenBit];
+            }
+        };
+        for (const auto& cluster : node.clusters) {
+            for (uint32_t& id : cluster->token_ids) {
+                remap_id(id);
+            }
+        }
+        for (uint32_t& id : node.token_matrix) {
+            remap_id(id);
         }
-        auto root_lock = root_.rlock();
-        auto drain_conf = drain_config_.rlock();
+        folly::F14FastMap<uint32_t, std::shared_ptr<Node>> children;
+        children.reserve(node.children.size());
+        for (auto& [key, child] : node.children) {
+            remap_token_ids(*child, remap);
+            remap_id(child->key);
+            const uint32_t new_key = child->key;
+            children.emplace(new_key, std::move(child));
+        }
+        node.children = std::move(children);
+    }
 
-        auto current_node = *root_lock;
-        std::string length_key = std::to_string(tokens.size());
+    /**
+     * Add a subtree and the clusters in its leaves to `usage`. Caller holds
+     * the shard lock; clusters are sized under the leaf lock so templates
+     * are never read while being widened.
+     */
+    static void node_bytes(const Node& node, DrainMemoryUsage& usage) {
+        ++usage.tree_nodes;
+        usage.tree_bytes += sizeof(Node);
+        {
+            std::shared_lock<folly::SharedMutex> leaf_read(node.leaf_mutex);
+            usage.tree_bytes += node.token_matrix.capacity() * sizeof(uint32_t);
+            if (node.clusters.capacity() > 8) {
+                usage.tree_bytes += node.clusters.capacity() * sizeof(std::shared_ptr<LogCluster>);
+            }
+            for (const auto& cluster : node.clusters) {
+                usage.cluster_bytes += cluster_bytes(*cluster);
+            }
+        }
+        usage.tree_bytes += node.children.size() * (sizeof(uint32_t) + sizeof(std::shared_ptr<Node>));
+        for (const auto& [key, child] : node.children) {
+            node_bytes(*child, usage);
+        }
+    }
 
-        auto iter = current_node->children.find(length_key);
-        if (iter == current_node->children.end()) {
-            // Not found
-            return std::make_shared<LogCluster>(-1, tokens);
+    static size_t cluster_bytes(const LogCluster& cluster) {
+        size_t bytes = sizeof(LogCluster) + cluster.log_template.capacity() +
+                       cluster.token_ids.capacity() * sizeof(uint32_t) +
+                       cluster.parameter_indices.size() * 2 * sizeof(size_t);
+        auto attributes = cluster.attributes.rlock();
+        for (const auto& [name, value] : *attributes) {
+            bytes += sizeof(name) + name.capacity() + sizeof(value) + value.capacity();
         }
-        current_node = iter->second;
+        return bytes;
+    }
 
-        const int max_depth = std::min(drain_conf->depth, static_cast<int>(tokens.size()));
-        for (int depth = 0; depth < max_depth; ++depth) {
-            std::string_view token = tokens[depth];
-            std::string token_key = detail::is_number(token) ? WILDCARD
-                                                             : std::string(token);
+    /**
+     * Create a cluster for `ids` in a leaf and register it. Caller holds the
+     * leaf lock exclusively and `ids` contains no unknown tokens.
+     */
+    std::shared_ptr<LogCluster> add_cluster(Node& leaf, const detail::TokenIdVector& ids) {
+        auto cluster = std::make_shared<LogCluster>(
+            cluster_id_counter_.fetch_add(1), ids, render_template(ids));
+        extract_parameters(ids, cluster);
+        cluster->leaf = &leaf;
+        touch(*cluster);
+        tree_cluster_count_.fetch_add(1, std::memory_order_relaxed);
+        leaf.clusters.push_back(cluster);
+        leaf.token_matrix.insert(leaf.token_matrix.end(), ids.begin(), ids.end());
+        clusters_.wlock()->emplace(cluster->id, cluster);
+
+        auto lock_t = templates_.wlock();
+        (*lock_t)[cluster->id] = cluster->log_template;
+        return cluster;
+    }
+
+    std::shared_ptr<LengthShard> get_or_create_shard(size_t num_tokens) {
+        {
+            auto shards = shards_.rlock();
+            auto it = shards->find(num_tokens);
+            if (it != shards->end()) {
+                return it->second;
+            }
+        }
+        auto shards = shards_.wlock();
+        auto& shard = (*shards)[num_tokens];
+        if (!shard) {
+            shard = std::make_shared<LengthShard>();
+        }
+        return shard;
+    }
 
+    /**
+     * Walk from a shard root down to the leaf for `ids`, following the
+     * same edge-selection rules whether or not new nodes may be added.
+     * Without `create`, returns nullptr where a node would have to be added.
+     */
+    static Node* descend(Node& shard_root, const detail::TokenIdVector& ids,
+                         const DrainConfig& drain_conf, bool create)
+    {
+        Node* current_node = &shard_root;
+        const int max_depth = std::min(drain_conf.depth, static_cast<int>(ids.size()));
+        for (int depth = 0; depth < max_depth; ++depth) {
+            uint32_t token_key = detail::is_number_token(ids[depth]) ? detail::kWildcardToken
+                                                                     : ids[depth];
             auto child_iter = current_node->children.find(token_key);
             if (child_iter == current_node->children.end()) {
-                // Try wildcard fallback
-                child_iter = current_node->children.find(WILDCARD);
-                if (child_iter == current_node->children.end()) {
-                    return std::make_shared<LogCluster>(-1, tokens);
+                // Possibly fallback to wildcard if children is at capacity
+                if ((int)current_node->children.size() >= drain_conf.max_children) {
+                    token_key = detail::kWildcardToken;
+                    child_iter = current_node->children.find(token_key);
                 }
             }
-            current_node = child_iter->second;
+            if (child_iter != current_node->children.end()) {
+                current_node = child_iter->second.get();
+                continue;
+            }
+            if (!create) {
+                return nullptr;
+            }
+            auto new_node = std::make_shared<Node>();
+            new_node->parent = current_node;
+            new_node->key = token_key;
+            current_node->children[token_key] = new_node;
+            current_node = new_node.get();
         }
+        return current_node;
+    }
 
-        // Now pick the best cluster that meets threshold
+    /**
+     * Add the tree path for `ids` and return its leaf. `tree_read` holds
+     * the shard lock shared on entry and on return but is dropped while the
+     * path is added; eviction may prune the new path in that gap, so it is
+     * looked up again once the shared lock is back.
+     */
+    static Node* add_path(LengthShard& shard,
+                          std::shared_lock<folly::SharedMutex>& tree_read,
+                          const detail::TokenIdVector& ids,
+                          const DrainConfig& drain_conf)
+    {
+        Node* leaf = nullptr;
+        while (!leaf) {
+            tree_read.unlock();
+            {
+                std::unique_lock<folly::SharedMutex> tree_write(shard.tree_mutex);
+                descend(shard.root, ids, drain_conf, /*create=*/true);
+            }
+            tree_read.lock();
+            leaf = descend(shard.root, ids, drain_conf, /*create=*/false);
+        }
+        return leaf;
+    }
+
+    /**
+     * Remove `node` and then every ancestor left with neither clusters nor
+     * children. Caller holds the shard lock exclusively.
+     */
+    static void prune(Node* node) {
+        while (node->parent && node->clusters.empty() && node->children.empty()) {
+            Node* parent = node->parent;
+            parent->children.erase(node->key);
+            node = parent;
+        }
+    }
+
+    /**
+     * Best cluster in a leaf at or above the threshold. Caller holds the leaf lock.
+     */
+    std::shared_ptr<LogCluster> best_cluster(const Node& leaf,
+                                             const detail::TokenIdVector& ids,
+                                             double similarity_threshold) const
+    {
+        const size_t width = ids.size();
         double max_similarity = -1.0;
         std::shared_ptr<LogCluster> matched_cluster = nullptr;
-        for (auto& cluster : current_node->clusters) {
-            double sim = calculate_similarity(cluster->tokens, tokens);
-            if (sim > max_similarity && sim >= drain_conf->similarity_threshold) {
+        const uint32_t* row = leaf.token_matrix.data();
+        for (size_t i = 0; i < leaf.clusters.size(); ++i, row += width) {
+            double sim = calculate_similarity(row, ids.data(), width);
+            if (sim > max_similarity && sim >= similarity_threshold) {
                 max_similarity = sim;
-                matched_cluster = cluster;
+                matched_cluster = leaf.clusters[i];
             }
         }
-        if (!matched_cluster) {
-            // Not found
-            return std::make_shared<LogCluster>(-1, tokens);
-        }
         return matched_cluster;
     }
 
     /**
-     * Compute similarity between two token vectors (simple example).
+     * Whether merging `ids` into the cluster would change its template.
      */
-    double calculate_similarity(const detail::TokenVector& t1,
-                                const detail::TokenVector& t2) const
-    {
-        size_t common = 0;
-        const size_t min_size = std::min(t1.size(), t2.size());
-        for (size_t i = 0; i < min_size; ++i) {
-            // If exact match or cluster token is wildcard
-            if (t1[i] == t2[i] || t1[i] == WILDCARD) {
-                ++common;
+    static bool needs_widening(const LogCluster& cluster, const detail::TokenIdVector& ids) {
+        const size_t min_sz = std::min(cluster.token_ids.size(), ids.size());
+        for (size_t i = 0; i < min_sz; ++i) {
+            if (cluster.token_ids[i] != ids[i] && cluster.token_ids[i] != detail::kWildcardToken) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static ClusterMatch snapshot(const std::shared_ptr<LogCluster>& cluster, bool with_template) {
+        ClusterMatch match{cluster, with_template ? cluster->log_template : std::string(), {}};
+        match.parameter_indices.assign(cluster->parameter_indices.begin(),
+                                       cluster->parameter_indices.end());
+        return match;
+    }
+
+    std::string render_template(const detail::TokenIdVector& ids) const {
+        std::string log_template;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (i > 0) log_template.push_back(' ');
+            std::string_view token = dictionary_.text(ids[i]);
+            log_template.append(token.data(), token.size());
+        }
+        return log_template;
+    }
+
+    /**
+     * ID of the existing cluster that best matches the tokens, or -1. Does NOT create a new cluster.
+     */
+    int find_matching_cluster_id(const detail::TokenVector& tokens) const {
+        if (tokens.empty()) {
+            return -1;
+        }
+        const DrainConfig drain_conf = drain_config_.copy();
+
+        std::shared_ptr<LengthShard> shard;
+        {
+            auto shards = shards_.rlock();
+            auto iter = shards->find(tokens.size());
+            if (iter == shards->end()) {
+                // Not found
+                return -1;
+            }
+            shard = iter->second;
+        }
+
+        std::shared_lock<folly::SharedMutex> ids_read(ids_mutex_);
+        detail::TokenIdVector ids;
+        dictionary_.encode(tokens, ids);
+
+        std::shared_lock<folly::SharedMutex> tree_read(shard->tree_mutex);
+        const Node* current_node = &shard->root;
+
+        const int max_depth = std::min(drain_conf.depth, static_cast<int>(ids.size()));
+        for (int depth = 0; depth < max_depth; ++depth) {
+            uint32_t token_key = detail::is_number_token(ids[depth]) ? detail::kWildcardToken
+                                                                     : ids[depth];
+
+            auto child_iter = current_node->children.find(token_key);
+            if (child_iter == current_node->children.end()) {
+                // Try wildcard fallback
+                child_iter = current_node->children.find(detail::kWildcardToken);
+                if (child_iter == current_node->children.end()) {
+                    return -1;
+                }
             }
+            current_node = child_iter->second.get();
         }
-        return double(common) / double(std::max(t1.size(), t2.size()));
+
+        // Now pick the best cluster that meets threshold
+        std::shared_lock<folly::SharedMutex> leaf_read(current_node->leaf_mutex);
+        auto matched_cluster = best_cluster(*current_node, ids, drain_conf.similarity_threshold);
+        return matched_cluster ? matched_cluster->id : -1;
+    }
+
+    /**
+     * Fraction of positions where a cluster row matches the line (cluster
+     * wildcards match anything).
+     */
+    static double calculate_similarity(const uint32_t* row, const uint32_t* ids, size_t width) {
+        return double(detail::count_token_matches(row, ids, width)) / double(width);
     }
 
     /**
      * Update a cluster template by merging in new tokens.
+     * Caller holds the leaf lock exclusively.
      */
-    void update_template(const std::shared_ptr<LogCluster>& cluster,
-                         const detail::TokenVector& tokens)
+    void update_template(Node& leaf,
+                         const std::shared_ptr<LogCluster>& cluster,
+                         const detail::TokenIdVector& ids)
     {
-        if (tokens.empty()) {
+        if (ids.empty()) {
             return;
         }
 
-        if (cluster->tokens.empty()) {
-            // Just copy directly
-            cluster->tokens = tokens;
-            extract_parameters(tokens, cluster);
-            cluster->update_template();
-            return;
-        }
+        const size_t row_index = std::find(leaf.clusters.begin(), leaf.clusters.end(), cluster)
+                                 - leaf.clusters.begin();
+        uint32_t* row = leaf.token_matrix.data() + row_index * ids.size();
 
-        size_t min_sz = std::min(cluster->tokens.size(), tokens.size());
+        size_t min_sz = std::min(cluster->token_ids.size(), ids.size());
         for (size_t i = 0; i < min_sz; ++i) {
-            if (cluster->tokens[i] != tokens[i] && cluster->tokens[i] != WILDCARD) {
-                // If both numeric, wildcard them
-                if (detail::is_number(cluster->tokens[i]) &&
-                    detail::is_number(tokens[i]))
-                {
-                    cluster->tokens[i] = WILDCARD;
-                    cluster->parameter_indices.insert(i);
-                }
-                else {
-                    // Different tokens => wildcard
-                    cluster->tokens[i] = WILDCARD;
-                    cluster->parameter_indices.insert(i);
-                }
+            if (cluster->token_ids[i] != ids[i] && cluster->token_ids[i] != detail::kWildcardToken) {
+                // Different tokens (numeric or not) => wildcard
+                cluster->token_ids[i] = detail::kWildcardToken;
+                row[i] = detail::kWildcardToken;
+                cluster->parameter_indices.insert(i);
             }
         }
-        cluster->update_template();
+        cluster->log_template = render_template(cluster->token_ids);
 
         // Update the templates map
         auto lock_t = templates_.wlock();
@@ -483,11 +2313,11 @@ private:
     /**
      * Mark likely parameters (numbers, etc.) as wildcard/parameters.
      */
-    void extract_parameters(const detail::TokenVector& tokens,
+    void extract_parameters(const detail::TokenIdVector& ids,
                             const std::shared_ptr<LogCluster>& cluster)
     {
-        for (size_t i = 0; i < tokens.size(); ++i) {
-            if (detail::is_number(tokens[i])) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (detail::is_number_token(ids[i])) {
                 cluster->parameter_indices.insert(i);
             }
         }
@@ -523,25 +2353,30 @@ private:
     }
 
     void extract_attributes(const detail::TokenVector& tokens,
-                          const folly::F14FastSet<size_t>& parameter_indices,
-                          std::vector<std::pair<std::string, std::string>>& attributes) {
-        attributes.clear();
+                          const std::vector<size_t>& parameter_indices,
+                          folly::Synchronized<std::vector<std::pair<std::string, std::string>>>& attributes) {
+        std::vector<std::pair<std::string, std::string>> extracted;
+        extracted.reserve(parameter_indices.size());
         for (size_t idx : parameter_indices) {
             if (idx < tokens.size()) {
                 std::string attr_name = "param_" + std::to_string(idx);
-                attributes.emplace_back(attr_name, std::string(tokens[idx]));
+                extracted.emplace_back(attr_name, std::string(tokens[idx]));
             }
         }
+        *attributes.wlock() = std::move(extracted);
     }
 
 private:
     // A thread-safe structure for the DRAIN configuration:
     folly::Synchronized<DrainConfig> drain_config_{{
-        /*depth=*/4, /*similarity_threshold=*/0.5, /*max_children=*/100
+        /*depth=*/4, /*similarity_threshold=*/0.5, /*max_children=*/100, /*max_clusters=*/0
     }};
 
-    // A thread-safe structure for the parse-tree root
-    folly::Synchronized<std::shared_ptr<Node>> root_;
+    // First tree level: token count -> independently locked subtree
+    folly::Synchronized<folly::F14FastMap<size_t, std::shared_ptr<LengthShard>>> shards_;
+
+    // Token text <-> ID; owns the bytes of every cluster token
+    detail::TokenDictionary dictionary_;
 
     // Cluster ID generator
     std::atomic<int> cluster_id_counter_;
@@ -550,6 +2385,27 @@ private:
     folly::Synchronized<folly::F14FastMap<int, std::string>> templates_;
 
     folly::Synchronized<folly::F14FastMap<int, std::shared_ptr<LogCluster>>> clusters_;
+
+    // Shared by every empty line; see empty_cluster()
+    std::once_flag empty_cluster_once_;
+    std::shared_ptr<LogCluster> empty_cluster_;
+
+    // Clusters currently in the tree; eviction keeps it near max_clusters
+    std::atomic<size_t> tree_cluster_count_{0};
+    std::mutex eviction_mutex_;
+
+    // Held shared for as long as token IDs are kept outside the dictionary
+    // lock, and exclusively by compact_dictionary() while it renumbers them
+    mutable folly::SharedMutex ids_mutex_;
+    // Dictionary size that triggers the next compaction; guarded by
+    // eviction_mutex_
+    static constexpr size_t kMinCompactTokens = 64 * 1024;
+    size_t compact_threshold_ = kMinCompactTokens;
+
+    // Matcher published by freeze(), or null while thawed. Swapped with
+    // std::atomic_store like the regex patterns; a replaced matcher is freed
+    // once the last lookup holding it returns.
+    std::shared_ptr<const FrozenDrain> frozen_;
 };
 
 // ============================================================================
@@ -561,7 +2417,8 @@ DrainParser::DrainParser(const DataLoaderConfig& config)
       impl_(std::make_unique<DrainParserImpl>(
           config.drain_depth,
           config.drain_similarity_threshold,
-          config.drain_max_children))
+          config.drain_max_children,
+          config.drain_max_clusters))
 {
 }
 
@@ -607,6 +2464,18 @@ void DrainParser::setSimilarityThreshold(double threshold) {
     impl_->set_similarity_threshold(threshold);
 }
 
+void DrainParser::setMaxClusters(size_t max_clusters) {
+    impl_->set_max_clusters(max_clusters);
+}
+
+void DrainParser::enforce_max_clusters() {
+    impl_->enforce_max_clusters();
+}
+
+DrainMemoryUsage DrainParser::memory_usage() const {
+    return impl_->memory_usage();
+}
+
 void DrainParser::set_preprocess_patterns(const std::vector<std::string>& pattern_strings) {
     impl_->set_preprocess_patterns(pattern_strings);
 }
@@ -619,6 +2488,38 @@ int DrainParser::get_cluster_id_for_log(std::string_view line) const {
     return impl_->get_cluster_id_for_log(line);
 }
 
+void DrainParser::freeze() {
+    impl_->freeze();
+}
+
+void DrainParser::thaw() {
+    impl_->thaw();
+}
+
+bool DrainParser::is_frozen() const {
+    return impl_->is_frozen();
+}
+
+std::vector<DrainClusterStats> DrainParser::get_all_cluster_stats(size_t minutes) const {
+    return impl_->get_all_cluster_stats(minutes);
+}
+
+std::optional<DrainClusterStats> DrainParser::get_cluster_stats(int cluster_id, size_t minutes) const {
+    return impl_->get_cluster_stats(cluster_id, minutes);
+}
+
+folly::F14FastMap<int, int> DrainParser::merge(const DrainParser& other) {
+    return impl_->merge(*other.impl_);
+}
+
+bool DrainParser::save_snapshot(const std::string& path) const {
+    return impl_->save_snapshot(path);
+}
+
+bool DrainParser::load_snapshot(const std::string& path) {
+    return impl_->load_snapshot(path);
+}
+
 std::vector<std::pair<std::string, std::string>> DrainParser::get_template_attributes(int cluster_id) const {
     return impl_->get_template_attributes(cluster_id);
 }
@@ -627,6 +2528,18 @@ folly::F14FastMap<int, std::string> DrainParser::get_all_templates() const {
     return impl_->get_all_templates();
 }
 
+void DrainParser::parse_batch(folly::Range<const std::string_view*> lines,
+                              DrainBatchResult& out,
+                              bool want_templates,
+                              bool want_parameters) {
+    impl_->parse_batch(lines, out, want_templates, want_parameters);
+}
+
+void DrainParser::parse_batch(folly::Range<const std::string_view*> lines,
+                              std::vector<LogRecordObject>& records) {
+    impl_->parse_batch_records(lines, records, user_config_);
+}
+
 std::optional<int> DrainParser::get_cluster_id_from_record(const LogRecordObject& record) const {
     return impl_->get_cluster_id_from_record(record);
 }
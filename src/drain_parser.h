@@ -3,13 +3,18 @@
 // ============================================================================
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <optional>
 #include <folly/FBString.h>
+#include <folly/Range.h>
 #include <folly/container/F14Map.h>
 #include <folly/container/F14Set.h>
+#include <folly/Synchronized.h>
 #include "log_parser.h"
 #include "data_loader_config.h"
 
@@ -18,28 +23,137 @@ namespace logai {
 // Forward declaration of the implementation class
 class DrainParserImpl;
 
-// String pool for interning common strings to reduce memory usage
+/**
+ * Thread-safe intern pool backed by an append-only arena.
+ *
+ * Interned views stay valid for the lifetime of the pool, so they can be
+ * stored in long-lived structures (cluster templates, tree edges) while the
+ * lines they came from are discarded. Lookups are heterogeneous on
+ * std::string_view and never allocate.
+ */
 class StringPool {
 public:
+    explicit StringPool(size_t block_size = 64 * 1024)
+        : block_size_(block_size) {}
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
     std::string_view intern(std::string_view str) {
         if (str.empty()) {
-            static const std::string empty;
-            return empty;
+            return {};
+        }
+        {
+            auto state = state_.rlock();
+            auto it = state->index.find(str);
+            if (it != state->index.end()) {
+                return *it;
+            }
         }
-        auto it = pool_.find(std::string(str));
-        if (it != pool_.end()) {
+        auto state = state_.wlock();
+        auto it = state->index.find(str);
+        if (it != state->index.end()) {
             return *it;
         }
-        auto result = pool_.insert(std::string(str));
-        return *result.first;
+        std::string_view stored = store(*state, str);
+        state->index.insert(stored);
+        return stored;
+    }
+
+    /**
+     * Interned copy of `str` if it has been interned before, without inserting.
+     */
+    std::optional<std::string_view> find(std::string_view str) const {
+        auto state = state_.rlock();
+        auto it = state->index.find(str);
+        if (it == state->index.end()) {
+            return std::nullopt;
+        }
+        return *it;
     }
 
     size_t size() const {
-        return pool_.size();
+        return state_.rlock()->index.size();
+    }
+
+    /**
+     * Bytes reserved by the arena (not counting the index).
+     */
+    size_t arena_bytes() const {
+        return state_.rlock()->arena_bytes;
     }
 
 private:
-    folly::F14FastSet<std::string> pool_;
+    struct State {
+        folly::F14FastSet<std::string_view> index;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t block_used = 0;
+        size_t block_capacity = 0;
+        size_t arena_bytes = 0;
+    };
+
+    std::string_view store(State& state, std::string_view str) {
+        // Oversized strings get a dedicated block so they don't waste the tail
+        // of the current one
+        if (str.size() > block_size_ / 4) {
+            auto block = std::make_unique<char[]>(str.size());
+            std::memcpy(block.get(), str.data(), str.size());
+            std::string_view stored(block.get(), str.size());
+            state.blocks.insert(state.blocks.begin(), std::move(block));
+            state.arena_bytes += str.size();
+            return stored;
+        }
+        if (state.blocks.empty() || state.block_capacity - state.block_used < str.size()) {
+            state.blocks.push_back(std::make_unique<char[]>(block_size_));
+            state.block_used = 0;
+            state.block_capacity = block_size_;
+            state.arena_bytes += block_size_;
+        }
+        char* dest = state.blocks.back().get() + state.block_used;
+        std::memcpy(dest, str.data(), str.size());
+        state.block_used += str.size();
+        return std::string_view(dest, str.size());
+    }
+
+    const size_t block_size_;
+    folly::Synchronized<State> state_;
+};
+
+/**
+ * Output of DrainParser::parse_batch. Entry i describes input line i;
+ * `templates` and `parameters` are left empty when not requested.
+ */
+struct DrainBatchResult {
+    std::vector<int> cluster_ids;
+    std::vector<std::string> templates;
+    std::vector<std::vector<std::string>> parameters;
+};
+
+/**
+ * Hit statistics for one cluster, from DrainParser::get_cluster_stats().
+ * Times are Unix epoch milliseconds taken when the lines were parsed.
+ */
+struct DrainClusterStats {
+    int cluster_id = -1;
+    std::string log_template;
+    uint64_t count = 0;
+    int64_t first_seen_ms = 0;  // 0 if never matched
+    int64_t last_seen_ms = 0;
+    std::vector<uint32_t> per_minute;  // per_minute[0] is the current minute, then going back
+};
+
+/**
+ * Approximate heap usage of a DrainParser, from DrainParser::memory_usage().
+ */
+struct DrainMemoryUsage {
+    size_t clusters = 0;
+    size_t tree_nodes = 0;
+    size_t dictionary_tokens = 0;
+    size_t tree_bytes = 0;        // Nodes, edges and leaf token rows
+    size_t cluster_bytes = 0;     // Clusters, templates and attributes
+    size_t dictionary_bytes = 0;  // Token arena and ID tables
+    size_t frozen_bytes = 0;      // Frozen matchers and mapped snapshots
+    size_t total_bytes = 0;
 };
 
 /**
@@ -60,6 +174,23 @@ public:
 
     LogRecordObject parse_line(const std::string& line) override;
 
+    /**
+     * Parse many lines at once. Config and dictionary locks are taken once
+     * per batch and each token-count shard once per group of lines, and no
+     * LogRecordObject is built. Skip templates/parameters when only cluster
+     * IDs are needed; cluster attributes and stats are updated either way.
+     */
+    void parse_batch(folly::Range<const std::string_view*> lines,
+                     DrainBatchResult& out,
+                     bool want_templates = true,
+                     bool want_parameters = true);
+
+    /**
+     * Batch equivalent of calling parse_line() on each line; appends to `records`.
+     */
+    void parse_batch(folly::Range<const std::string_view*> lines,
+                     std::vector<LogRecordObject>& records);
+
     /**
      * Set the maximum depth of the parse tree
      */
@@ -70,6 +201,19 @@ public:
      */
     void setSimilarityThreshold(double threshold);
 
+    /**
+     * Cap the number of clusters; beyond it the least recently matched ones
+     * are evicted from the tree and the ID maps. Tree paths they leave
+     * empty are pruned, and the token dictionary is rebuilt without their
+     * tokens once it has doubled. 0 removes the cap.
+     */
+    void setMaxClusters(size_t max_clusters);
+
+    /**
+     * Approximate memory held by this parser
+     */
+    DrainMemoryUsage memory_usage() const;
+
     /**
      * Set custom regex patterns for log preprocessing
      */
@@ -85,6 +229,67 @@ public:
      */
     int get_cluster_id_for_log(std::string_view line) const;
 
+    /**
+     * Compile the current parse tree into an immutable matcher that
+     * get_cluster_id_for_log() uses from then on. Frozen lookups never
+     * touch the live tree's locks and do not allocate; clusters learned by
+     * later parse() calls are only visible after freezing again. The
+     * previous matcher is freed once no lookup is using it.
+     */
+    void freeze();
+
+    /**
+     * Send get_cluster_id_for_log() back to the live tree
+     */
+    void thaw();
+
+    bool is_frozen() const;
+
+    /**
+     * Per-cluster counts, first/last seen times and the last `minutes`
+     * (at most 60) per-minute hit counts, sorted by cluster ID. Counters
+     * are read without locking, so each cluster is a consistent-enough
+     * point-in-time view rather than an exact one.
+     */
+    std::vector<DrainClusterStats> get_all_cluster_stats(size_t minutes = 60) const;
+
+    /**
+     * Statistics for one cluster, or nullopt if the ID is unknown
+     */
+    std::optional<DrainClusterStats> get_cluster_stats(int cluster_id, size_t minutes = 60) const;
+
+    /**
+     * Fold another parser's clusters into this one, e.g. states trained on
+     * separate threads, files or hosts (load the latter with
+     * load_snapshot()). Clusters are taken in ascending ID order, so the
+     * result depends only on the two states. Returns `other`'s cluster IDs
+     * mapped to IDs in this parser. `other` must not be parsing concurrently.
+     *
+     * Merging never evicts, so every returned ID is still live; call
+     * enforce_max_clusters() once the callers' records have been remapped.
+     */
+    folly::F14FastMap<int, int> merge(const DrainParser& other);
+
+    /**
+     * Evict down to the setMaxClusters() cap now rather than on the next parse
+     */
+    void enforce_max_clusters();
+
+    /**
+     * Write the learned tree, clusters, parameter positions and cluster ID
+     * counter to a versioned binary snapshot. Returns false on I/O failure.
+     */
+    bool save_snapshot(const std::string& path) const;
+
+    /**
+     * Warm-start from a save_snapshot() file. The file is mapped read-only
+     * and serves get_cluster_id_for_log() immediately as a frozen matcher
+     * (see freeze()), while the live tree is rebuilt from it so parse()
+     * keeps learning. Only valid before anything has been parsed; depth,
+     * threshold and max children are taken from the snapshot.
+     */
+    bool load_snapshot(const std::string& path);
+
     /**
      * Get all templates with their cluster IDs
      */
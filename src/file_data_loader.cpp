@@ -5,6 +5,8 @@
  * For full license text, see the LICENSE file in the repo root or https://opensource.org/licenses/BSD-3-Clause
  */
 
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -12,8 +14,19 @@
 #include <iostream>
 #include <algorithm>
 #include <chrono>
+#include <limits>
+#include <mutex>
 #include <thread>
 #include "file_data_loader.h"
+#include "thread_pool.h"
+#include "reorder_buffer.h"
+#include "memory_budget.h"
+#include "gzip_index.h"
+#include "zstd_index.h"
+#include "uring_file_reader.h"
+#include "mapped_window_reader.h"
+#include "multiline_detector.h"
+#include "ingest_checkpoint.h"
 #include "csv_parser.h"
 #include "json_parser.h"
 #include "regex_parser.h"
@@ -44,6 +57,7 @@
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filter/bzip2.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
 #include <folly/String.h>
 #include <folly/FBVector.h>
 #include <folly/container/F14Map.h>
@@ -61,6 +75,206 @@ constexpr char SPAN_ID[] = "span_id";
 constexpr char LOG_TIMESTAMPS[] = "timestamp";
 constexpr char LABELS[] = "labels";
 
+namespace {
+
+/**
+ * Call on_line(std::string_view) for every non-empty line in [begin, end),
+ * skipping lines of MAX_LINE_LENGTH or more. Returns the number of lines
+ * passed to on_line.
+ */
+template <typename Fn>
+size_t for_each_line(const char* begin, const char* end, Fn&& on_line) {
+    size_t line_count = 0;
+    const char* line_start = begin;
+    while (line_start < end) {
+        const char* line_end = static_cast<const char*>(
+            std::memchr(line_start, '\n', end - line_start));
+        if (!line_end) {
+            line_end = end;
+        }
+
+        size_t line_length = line_end - line_start;
+        if (line_length > 0 && line_length < MAX_LINE_LENGTH) {
+            on_line(std::string_view(line_start, line_length));
+            line_count++;
+        } else if (line_length >= MAX_LINE_LENGTH) {
+            spdlog::error("Skipping line {} (length: {}): Line too long", line_count, line_length);
+        }
+
+        // Move to the next line
+        line_start = (line_end < end) ? line_end + 1 : end;
+    }
+    return line_count;
+}
+
+// Decompressed bytes buffered by a region task before its lines are parsed
+constexpr size_t kStreamParseChunk = 4 << 20;
+
+std::string path_extension(const std::string& path) {
+    auto pos = path.find_last_of('.');
+    return pos == std::string::npos ? "" : path.substr(pos + 1);
+}
+
+/**
+ * Cut blocks of a file, handed over in order, into lines. on_line gets each
+ * line plus the block holding it; a line spanning blocks is first copied
+ * into a string of its own, which then serves as its block.
+ */
+template <typename Fn>
+class BlockLineSplitter {
+public:
+    explicit BlockLineSplitter(Fn& on_line) : on_line_(on_line) {}
+
+    void add(const std::shared_ptr<const char>& block, size_t size) {
+        const char* begin = block.get();
+        const char* end = begin + size;
+        if (!carry_.empty()) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', size));
+            if (!newline) {
+                carry_.append(begin, size);
+                return;
+            }
+            carry_.append(begin, newline - begin);
+            flush_carry();
+            begin = newline + 1;
+        }
+        const char* last = static_cast<const char*>(memrchr(begin, '\n', end - begin));
+        const char* complete = last ? last + 1 : begin;
+        carry_.assign(complete, end);
+
+        std::shared_ptr<const void> source = block;
+        for_each_line(begin, complete, [&](std::string_view line) {
+            on_line_(line, source);
+        });
+    }
+
+    /** Emit the last line if the file does not end with a newline. */
+    void finish() {
+        if (!carry_.empty()) {
+            flush_carry();
+        }
+    }
+
+private:
+    void flush_carry() {
+        auto joined = std::make_shared<const std::string>(std::move(carry_));
+        carry_.clear();
+        std::shared_ptr<const void> source = joined;
+        for_each_line(joined->data(), joined->data() + joined->size(), [&](std::string_view line) {
+            on_line_(line, source);
+        });
+    }
+
+    Fn& on_line_;
+    std::string carry_;
+};
+
+/**
+ * Split [0, size) into at most `parts` byte ranges whose boundaries fall
+ * just after a newline, so no line straddles two ranges.
+ */
+std::vector<std::pair<size_t, size_t>> split_at_newlines(const char* data, size_t size, size_t parts) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t begin = 0;
+    for (size_t i = 1; i <= parts && begin < size; ++i) {
+        size_t end = (i == parts) ? size : std::max(begin, size / parts * i);
+        if (end < size) {
+            const void* newline = std::memchr(data + end, '\n', size - end);
+            end = newline ? static_cast<const char*>(newline) - data + 1 : size;
+        }
+        if (end > begin) {
+            ranges.emplace_back(begin, end);
+            begin = end;
+        }
+    }
+    return ranges;
+}
+
+// Approximate heap bytes held by a batch of raw lines (the mapped file
+// itself is page cache and not counted)
+size_t approximate_bytes(const LogBatch& batch) {
+    size_t bytes = sizeof(LogBatch) + batch.lines.capacity() * sizeof(std::string_view);
+    for (const auto& line : batch.owned) {
+        bytes += sizeof(std::string) + line.capacity();
+    }
+    return bytes;
+}
+
+// Approximate heap bytes held by parsed records
+size_t approximate_bytes(const std::vector<LogRecordObject>& records) {
+    size_t bytes = records.capacity() * sizeof(LogRecordObject);
+    for (const auto& record : records) {
+        bytes += record.body.capacity() + record.template_str.capacity() +
+                 record.level.capacity() + record.message.capacity();
+        for (const auto& [key, value] : record.fields) {
+            bytes += 2 * sizeof(folly::fbstring) + key.size() + value.size();
+        }
+    }
+    return bytes;
+}
+
+/**
+ * Parsers shared by batch tasks. Each running task borrows one, so there are
+ * only ever as many as there were tasks running at once; the index a parser
+ * was created with identifies it in take()'s result.
+ *
+ * A `shared` set hands every task the same parser, for parsers that are
+ * thread-safe and whose output must agree across batches.
+ */
+class ParserSet {
+public:
+    explicit ParserSet(std::function<std::unique_ptr<LogParser>()> factory, bool shared = false)
+        : factory_(std::move(factory)), shared_(shared) {}
+
+    std::pair<size_t, LogParser*> acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (shared_ && !parsers_.empty()) {
+                return {0, parsers_[0].get()};
+            }
+            if (!shared_ && !free_.empty()) {
+                size_t index = free_.back();
+                free_.pop_back();
+                return {index, parsers_[index].get()};
+            }
+        }
+        auto parser = factory_();
+        if (!parser) {
+            throw std::runtime_error("Failed to create parser in worker task");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (shared_ && !parsers_.empty()) {
+            // Another task created it first
+            return {0, parsers_[0].get()};
+        }
+        parsers_.push_back(std::move(parser));
+        return {parsers_.size() - 1, parsers_.back().get()};
+    }
+
+    void release(size_t index) {
+        if (shared_) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(index);
+    }
+
+    std::vector<std::unique_ptr<LogParser>> take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.clear();
+        return std::move(parsers_);
+    }
+
+private:
+    std::function<std::unique_ptr<LogParser>()> factory_;
+    const bool shared_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<LogParser>> parsers_;
+    std::vector<size_t> free_;
+};
+
+} // namespace
+
 FileDataLoader::FileDataLoader(const std::string& filepath, const FileDataLoaderConfig& config)
     : filepath_(filepath), config_(config) {
     initInputStream();
@@ -107,6 +321,8 @@ std::unique_ptr<std::istream> FileDataLoader::openCompressedFile() {
         buffer->push(bio::bzip2_decompressor());
     } else if (ext == "z") {
         buffer->push(bio::zlib_decompressor());
+    } else if (ext == "zst" || ext == "zstd") {
+        buffer->push(bio::zstd_decompressor());
     } else {
         throw std::runtime_error("Unsupported compression format: " + ext);
     }
@@ -124,7 +340,7 @@ void FileDataLoader::loadData(std::vector<LogParser::LogEntry>& entries) {
         std::getline(*input_stream_, line);
     }
 
-    while (input_stream_->good()) {
+    while (hasMoreInput()) {
         if (config_.logical_lines) {
             auto logical_line = readLogicalLine();
             if (!logical_line.empty()) {
@@ -151,7 +367,7 @@ void FileDataLoader::streamData(const std::function<bool(const LogParser::LogEnt
         std::getline(*input_stream_, line);
     }
 
-    while (input_stream_->good()) {
+    while (hasMoreInput()) {
         if (config_.logical_lines) {
             auto logical_line = readLogicalLine();
             if (!logical_line.empty() && parser_->validate(logical_line)) {
@@ -184,7 +400,7 @@ void FileDataLoader::processInChunks(size_t chunk_size,
         std::getline(*input_stream_, line);
     }
 
-    while (input_stream_->good()) {
+    while (hasMoreInput()) {
         if (config_.logical_lines) {
             auto logical_line = readLogicalLine();
             if (!logical_line.empty() && parser_->validate(logical_line)) {
@@ -216,66 +432,61 @@ void FileDataLoader::processInChunks(size_t chunk_size,
     }
 }
 
+bool FileDataLoader::readLine(std::string& line) {
+    if (has_lookahead_) {
+        line = std::move(lookahead_);
+        has_lookahead_ = false;
+        return true;
+    }
+    return static_cast<bool>(std::getline(*input_stream_, line));
+}
+
+bool FileDataLoader::hasMoreInput() const {
+    return has_lookahead_ || input_stream_->good();
+}
+
 std::string FileDataLoader::readLogicalLine() {
-    std::string current_line;
-    std::string line;
+    if (!line_detector_) {
+        line_detector_ = std::make_unique<MultilineDetector>(multiline_rules());
+    }
 
-    // Read first line
-    if (!std::getline(*input_stream_, line)) {
+    std::string line;
+    if (!readLine(line)) {
         return "";
     }
-
     boost::trim(line);
     if (line.empty()) {
         return "";
     }
 
-    current_line = line;
-
-    // Keep reading while we see continuation markers
-    while (input_stream_->good() && isLogicalLineContinuation(line)) {
-        if (!std::getline(*input_stream_, line)) {
-            break;
-        }
-
-        if (line.empty()) {
+    // Read ahead one line to see whether it continues this record; if not,
+    // it is kept for the next call
+    std::string record = line;
+    std::string previous = std::move(line);
+    std::string next;
+    while (readLine(next)) {
+        boost::trim_right(next);
+        if (!line_detector_->continues(next, previous)) {
+            lookahead_ = std::move(next);
+            has_lookahead_ = true;
             break;
         }
-
-        // Handle different continuation styles
-        if (boost::starts_with(line, " ") || boost::starts_with(line, "\t")) {
-            current_line = handleIndentationContinuation(line, current_line);
-        } else if (boost::ends_with(current_line, "\\")) {
-            current_line = handleBackslashContinuation(line, current_line);
-        }
+        MultilineDetector::append(record, next);
+        previous = std::move(next);
     }
-
-    return current_line;
-}
-
-bool FileDataLoader::isLogicalLineContinuation(const std::string& line) {
-    return boost::ends_with(line, "\\") || 
-           (input_stream_->good() && 
-            std::streampos(input_stream_->tellg()) < std::streampos(input_stream_->seekg(0, std::ios::end).tellg()) &&
-            (boost::starts_with(line, " ") || boost::starts_with(line, "\t")));
+    return record;
 }
 
-std::string FileDataLoader::handleIndentationContinuation(const std::string& line, std::string& current_line) {
-    std::string trimmed_line = line;
-    boost::trim_left(trimmed_line);
-    return current_line + " " + trimmed_line;
-}
-
-std::string FileDataLoader::handleBackslashContinuation(const std::string& line, std::string& current_line) {
-    // Remove backslash and join with next line
-    current_line.pop_back();  // Remove backslash
-    boost::trim(current_line);
-    return current_line + line;
+MultilineRules FileDataLoader::multiline_rules() const {
+    MultilineRules rules;
+    rules.start_pattern = config_.record_start_pattern;
+    rules.timestamp_start = config_.record_timestamp_start;
+    return rules;
 }
 
 bool FileDataLoader::isCompressedFile() const {
     auto ext = getFileExtension();
-    return ext == "gz" || ext == "gzip" || ext == "bz2" || ext == "z";
+    return ext == "gz" || ext == "gzip" || ext == "bz2" || ext == "z" || ext == "zst" || ext == "zstd";
 }
 
 std::string FileDataLoader::getFileExtension() const {
@@ -302,367 +513,865 @@ std::vector<LogRecordObject> FileDataLoader::load_data() {
         throw std::runtime_error("File does not exist: " + filepath);
     }
     
-    std::vector<LogRecordObject> results;
-    running_ = true;
-    std::atomic<size_t> total_batches_{0};
-    
-    // Create queues for the producer-consumer pattern
-    ThreadSafeQueue<LogBatch> input_queue;
-    ThreadSafeQueue<ProcessedBatch> output_queue;
-    
-    // Start the producer thread to read the file
-    MemoryMappedFile file;
-    std::thread producer([this, &file, &input_queue, &total_batches_]() {
-        producer_thread(file, input_queue, total_batches_);
-    });
-    
     // Determine number of worker threads
     size_t num_threads = config_.num_threads > 0 ? 
                         config_.num_threads : 
                         std::thread::hardware_concurrency();
-    
-    // Start worker threads to process batches
-    std::vector<std::thread> workers;
-    for (size_t i = 0; i < num_threads; i++) {
-        workers.push_back(std::thread([this, &input_queue, &output_queue]() {
-            worker_thread(input_queue, output_queue);
-        }));
+
+    const auto ext = path_extension(filepath);
+    if (config_.use_memory_mapping && (ext == "gz" || ext == "gzip")) {
+        return load_data_gzip(std::max<size_t>(num_threads, 1));
     }
-    
-    // Start consumer thread to collect results
-    std::thread consumer([this, num_threads, &output_queue, &results, &total_batches_]() {
-        consumer_thread(num_threads, output_queue, results, total_batches_);
-    });
-    
-    // Wait for all threads to complete
-    producer.join();
-    for (auto& worker : workers) {
-        worker.join();
+    if (config_.use_memory_mapping && (ext == "zst" || ext == "zstd")) {
+        return load_data_zstd(std::max<size_t>(num_threads, 1));
+    }
+    if (config_.use_memory_mapping && config_.incremental) {
+        return load_data_incremental(std::max<size_t>(num_threads, 1));
     }
+    // Multi-line records are assembled per byte range, so they take the
+    // split path too
+    if (config_.use_memory_mapping && (config_.split_byte_ranges || config_.logical_lines)) {
+        return load_data_split(std::max<size_t>(num_threads, 1));
+    }
+    
+    std::vector<LogRecordObject> results;
+    running_ = true;
     
-    // Signal that no more processed batches will be produced
-    output_queue.done();
-    consumer.join();
+    // Batches are parsed as tasks on the shared thread pool and handed back
+    // here in file order. Nothing is returned before the whole file is
+    // parsed, so tasks learn into private parsers that are merged at the end;
+    // remember which parser produced each span of records.
+    std::vector<std::pair<size_t, size_t>> record_workers;
+    auto worker_parsers = parse_batches([&](ProcessedBatch& batch) {
+        results.insert(results.end(), 
+                      std::make_move_iterator(batch.records.begin()), 
+                      std::make_move_iterator(batch.records.end()));
+        // (end of this batch's records, parser that produced them)
+        record_workers.emplace_back(results.size(), batch.worker);
+    }, false, config_.memory_budget_mb << 20);
+
+    merge_drain_workers(worker_parsers, record_workers, results);
     
     running_ = false;
     return results;
 }
 
-std::unique_ptr<LogParser> FileDataLoader::create_parser() {
-    if (config_.log_type == "csv") {
-        return std::make_unique<CsvParser>(config_);
-    } else if (config_.log_type == "json") {
-        return std::make_unique<JsonParser>(config_);
-    } else if (config_.log_type == "drain") {
-        // Use the high-performance DRAIN parser for log pattern parsing
-        return std::make_unique<DrainParser>(config_);
-    } else {
-        // Default to regex parser for custom log formats
-        return std::make_unique<RegexParser>(config_, config_.log_pattern);
+bool FileDataLoader::ensure_line_index() {
+    const std::string& path = filepath_.empty() ? config_.file_path : filepath_;
+    if (line_index_ && line_index_->is_current(path)) {
+        return true;
     }
+    // First use, or the file grew or was rewritten since it was indexed:
+    // drop the old mapping along with the index that describes it
+    line_index_.reset();
+    line_file_.reset();
+    auto index = std::make_unique<LineIndex>();
+    if (!index->open(path)) {
+        return false;
+    }
+    auto file = std::make_unique<MemoryMappedFile>();
+    if (index->line_count() > 0 && !file->open(path)) {
+        spdlog::error("Failed to map file: {}", path);
+        return false;
+    }
+    line_file_ = std::move(file);
+    line_index_ = std::move(index);
+    return true;
 }
 
-void FileDataLoader::worker_thread(ThreadSafeQueue<LogBatch>& input_queue, 
-                                 ThreadSafeQueue<ProcessedBatch>& output_queue) {
-    try {
-        // Create parser once per thread
-        auto parser = create_parser();
-        if (!parser) {
-            throw std::runtime_error("Failed to create parser in worker thread");
-        }
-        
-        std::cout << "Worker thread started" << std::endl;
-        
-        while (true) {
-            LogBatch batch;
-            if (!input_queue.wait_and_pop(batch)) {
-                break; // Queue is done and empty
-            }
-            
-            // Process the batch
-            ProcessedBatch processed_batch;
-            processed_batch.id = batch.id;
-            processed_batch.records.reserve(batch.lines.size());
-            
-            size_t success_count = 0;
-            size_t error_count = 0;
-            
-            for (const auto& line : batch.lines) {
-                try {
-                    if (!line.empty()) {
-                        auto record = parser->parse_line(line);
-                        processed_batch.records.push_back(std::move(record));
-                        success_count++;
-                    }
-                } catch (const std::exception& e) {
-                    error_count++;
-                    if (error_count < 10) { // Limit error messages to avoid flooding logs
-                        std::cerr << "Error parsing line: " << e.what() << std::endl;
-                        if (line.length() < 200) { // Only print short lines to avoid flooding logs
-                            std::cerr << "Line content: " << line << std::endl;
-                        } else {
-                            std::cerr << "Line too long to display (" << line.length() << " chars)" << std::endl;
-                        }
-                    } else if (error_count == 10) {
-                        std::cerr << "Too many parsing errors, suppressing further messages..." << std::endl;
-                    }
-                }
-            }
-            
-            if (batch.id % 10 == 0 || error_count > 0) {
-                spdlog::info("Processed batch {}: {} successes, {} errors", 
-                            batch.id, success_count, error_count);
-            }
-            
-            // Push the processed batch to the output queue
-            output_queue.push(std::move(processed_batch));
-        }
-        
-        spdlog::info("Worker thread finished");
-    } catch (const std::exception& e) {
-        spdlog::error("Error in worker thread: {}", e.what());
+std::vector<std::string> FileDataLoader::read_lines(size_t start, size_t count) {
+    std::lock_guard<std::mutex> lock(line_index_mutex_);
+    std::vector<std::string> lines;
+    if (!ensure_line_index()) {
+        return lines;
+    }
+    std::string_view contents(line_file_->data(), line_file_->size());
+    size_t end = std::min(line_index_->line_count(), start + std::min(count, line_index_->line_count()));
+    for (size_t i = start; i < end; ++i) {
+        lines.emplace_back(line_index_->line(contents, i));
     }
+    return lines;
 }
 
-void FileDataLoader::consumer_thread(size_t num_threads, ThreadSafeQueue<ProcessedBatch>& output_queue, 
-                                    std::vector<LogRecordObject>& results,
-                                    std::atomic<size_t>& total_batches) {
-    size_t processed_count = 0;
-    size_t expected_count = total_batches.load();
-    
-    while (true) {
-        ProcessedBatch batch;
-        if (!output_queue.wait_and_pop(batch)) {
-            break; // Queue is done and empty
+size_t FileDataLoader::line_count() {
+    std::lock_guard<std::mutex> lock(line_index_mutex_);
+    return ensure_line_index() ? line_index_->line_count() : 0;
+}
+
+std::vector<LogRecordObject> FileDataLoader::load_data_split(size_t num_threads) {
+    auto mapping = std::make_shared<MemoryMappedFile>();
+    if (!mapping->open(config_.file_path)) {
+        throw std::runtime_error("Failed to map file: " + config_.file_path);
+    }
+    return parse_mapped_range(mapping, 0, mapping->size(), num_threads);
+}
+
+std::vector<LogRecordObject> FileDataLoader::load_data_incremental(size_t num_threads) {
+    const std::string& path = config_.file_path;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::runtime_error("Failed to stat file: " + path);
+    }
+    if (st.st_size == 0) {
+        return {};
+    }
+    auto mapping = std::make_shared<MemoryMappedFile>();
+    if (!mapping->open(path)) {
+        throw std::runtime_error("Failed to map file: " + path);
+    }
+    const char* data = mapping->data();
+    const uint64_t size = mapping->size();
+    const uint64_t inode = static_cast<uint64_t>(st.st_ino);
+    const uint64_t fingerprint = settings_fingerprint();
+
+    IngestCheckpoint checkpoint;
+    uint64_t begin = 0;
+    if (checkpoint.load_sidecar(path)) {
+        if (checkpoint.matches(data, size, inode, fingerprint)) {
+            begin = checkpoint.offset;
+            spdlog::info("Resuming {} at offset {} of {}", path, begin, size);
+        } else {
+            spdlog::info("{} changed since its last checkpoint, parsing it from the start", path);
         }
-        
-        // Add the processed records to the results
-        results.insert(results.end(), 
-                      std::make_move_iterator(batch.records.begin()), 
-                      std::make_move_iterator(batch.records.end()));
-        
-        processed_count++;
-        
-        // If we've processed all expected batches, we're done
-        if (processed_count >= expected_count && expected_count > 0) {
+    }
+    // Resumed DRAIN parsing must start from the clusters learned before the
+    // checkpoint, or the appended lines would get unrelated cluster IDs
+    const std::string drain_snapshot = IngestCheckpoint::drain_snapshot_path(path);
+    std::unique_ptr<LogParser> resumed_parser;
+    if (begin > 0) {
+        resumed_parser = create_parser();
+        auto* drain_parser = dynamic_cast<DrainParser*>(resumed_parser.get());
+        if (!drain_parser) {
+            resumed_parser.reset();
+        } else if (!fs::exists(drain_snapshot) || !drain_parser->load_snapshot(drain_snapshot)) {
+            spdlog::warn("No usable DRAIN snapshot for {}, parsing it from the start", path);
+            resumed_parser.reset();
+            begin = 0;
+        }
+    }
+    if (begin == 0) {
+        // DRAIN state learned from an earlier version of the file no longer applies
+        std::remove(drain_snapshot.c_str());
+    }
+
+    // A trailing line without its newline may still be being written; it is
+    // left for the next run
+    uint64_t end = begin;
+    for (uint64_t pos = size; pos > begin; --pos) {
+        if (data[pos - 1] == '\n') {
+            end = pos;
             break;
         }
     }
+
+    auto results = parse_mapped_range(mapping, begin, end, num_threads, drain_snapshot,
+                                      std::move(resumed_parser));
+
+    if (end > begin || begin == 0) {
+        checkpoint.inode = inode;
+        checkpoint.offset = end;
+        checkpoint.prefix_hash = IngestCheckpoint::hash_prefix(data, end);
+        checkpoint.fingerprint = fingerprint;
+        if (!checkpoint.save_sidecar(path)) {
+            spdlog::warn("Could not write ingest checkpoint for {}", path);
+        }
+    }
+    return results;
 }
 
-void FileDataLoader::producer_thread([[maybe_unused]] MemoryMappedFile& file, ThreadSafeQueue<LogBatch>& input_queue, 
-                                    std::atomic<size_t>& total_batches) {
-    try {
-        if (config_.use_memory_mapping) {
-            // Use a vector to collect lines in batches
-            std::vector<std::string> batch_lines;
-            batch_lines.reserve(current_batch_size_.load()); // Use adaptive batch size
-            size_t batch_id = 0;
-            size_t lines_processed = 0;
-            
-            read_file_memory_mapped(config_.file_path, [&](std::string_view line) {
-                try {
-                    // Check if the string_view is valid before creating a string from it
-                    if (line.data() && line.size() > 0 && line.size() < MAX_LINE_LENGTH) {
-                        // Create a safe copy of the string_view
-                        std::string line_copy;
-                        line_copy.reserve(line.size());
-                        line_copy.assign(line.data(), line.size());
-                        
-                        // Add to current batch
-                        batch_lines.push_back(std::move(line_copy));
-                        lines_processed++;
-                        
-                        // If batch is full, push it to the queue
-                        size_t current_batch_size = current_batch_size_.load();
-                        if (batch_lines.size() >= current_batch_size) {
-                            LogBatch batch{batch_id++, std::move(batch_lines)};
-                            input_queue.push(std::move(batch));
-                            
-                            // Reset batch_lines for next batch
-                            batch_lines = std::vector<std::string>();
-                            batch_lines.reserve(current_batch_size);
-                            
-                            // Update total batches
-                            total_batches.store(batch_id);
-                            
-                            // Adjust batch size based on queue size and memory usage
-                            adjust_batch_size(input_queue);
-                            
-                            // If memory pressure is high, pause briefly to let consumers catch up
-                            if (memory_pressure_.load()) {
-                                size_t queue_size = input_queue.size();
-                                if (queue_size > queue_high_watermark_.load()) {
-                                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                                }
-                            }
+uint64_t FileDataLoader::settings_fingerprint() const {
+    // Everything that changes which records a line produces. The DRAIN
+    // snapshot carries its own tree settings, so resuming it under different
+    // ones would mix two trees: changed drain_* settings reparse too.
+    std::ostringstream settings;
+    settings.precision(17);
+    settings << config_.format << '\0' << config_.log_type << '\0' << config_.log_pattern << '\0'
+             << config_.logical_lines << '\0' << config_.record_start_pattern << '\0'
+             << config_.record_timestamp_start << '\0' << config_.drain_depth << '\0'
+             << config_.drain_similarity_threshold << '\0' << config_.drain_max_children << '\0'
+             << config_.drain_max_clusters;
+    return IngestCheckpoint::hash(settings.str());
+}
+
+std::vector<LogRecordObject> FileDataLoader::parse_mapped_range(const std::shared_ptr<MemoryMappedFile>& mapping,
+                                                                uint64_t begin, uint64_t end, size_t num_threads,
+                                                                const std::string& drain_snapshot,
+                                                                std::unique_ptr<LogParser> first_parser) {
+    running_ = true;
+
+    // Each task scans and parses its own newline-aligned slice of the
+    // mapping, so no single thread has to find every line break
+    auto ranges = split_at_newlines(mapping->data() + begin, end - begin, num_threads);
+    for (auto& range : ranges) {
+        range.first += begin;
+        range.second += begin;
+    }
+    spdlog::info("Processing {} bytes of memory mapped file of size: {} bytes in {} ranges",
+                 end - begin, mapping->size(), ranges.size());
+
+    const MultilineDetector detector(multiline_rules());
+    std::vector<std::vector<LogRecordObject>> range_results(ranges.size());
+    std::vector<std::unique_ptr<LogParser>> worker_parsers(ranges.size());
+    TaskGroup workers;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        workers.run([this, &mapping, &ranges, &detector, &range_results, &worker_parsers,
+                     &first_parser, end, i]() {
+            try {
+                // The other workers' clusters are merged into worker 0's, so
+                // the state it starts from carries over
+                auto parser = i == 0 && first_parser ? std::move(first_parser) : create_parser();
+                if (!parser) {
+                    throw std::runtime_error("Failed to create parser in worker task");
+                }
+                auto* drain_parser = dynamic_cast<DrainParser*>(parser.get());
+                const size_t batch_size = std::max<size_t>(config_.batch_size, 1);
+
+                LogBatch batch;
+                batch.sources.push_back(mapping);
+                ProcessedBatch processed_batch;
+                processed_batch.worker = i;
+                auto flush = [&]() {
+                    processed_batch.id = batch.id;
+                    parse_batch_lines(*parser, drain_parser, batch, processed_batch);
+                    batch.lines.clear();
+                    // Drop joined records, keep the mapping
+                    batch.sources.resize(1);
+                    batch.id++;
+                };
+
+                const char* data = mapping->data();
+                size_t lines = 0;
+                if (config_.logical_lines) {
+                    lines = detector.for_each_record(data, end, ranges[i].first, ranges[i].second,
+                                                     [&](std::string_view record, bool copied) {
+                        if (record.size() >= MAX_LINE_LENGTH) {
+                            spdlog::error("Skipping record (length: {}): Record too long", record.size());
+                            return;
                         }
-                        
-                        // Report progress periodically
-                        if (lines_processed % 10000 == 0) {
-                            spdlog::info("Processed {} lines", lines_processed);
+                        if (copied) {
+                            auto joined = std::make_shared<const std::string>(record);
+                            record = *joined;
+                            batch.sources.push_back(std::move(joined));
                         }
-                    }
-                } catch (const std::exception& e) {
-                    spdlog::error("Error creating batch: {}", e.what());
+                        batch.lines.push_back(record);
+                        if (batch.lines.size() >= batch_size) {
+                            flush();
+                        }
+                    });
+                } else {
+                    lines = for_each_line(data + ranges[i].first, data + ranges[i].second,
+                                          [&](std::string_view line) {
+                        batch.lines.push_back(line);
+                        if (batch.lines.size() >= batch_size) {
+                            flush();
+                        }
+                    });
                 }
-            });
-            
-            // Push any remaining lines
-            if (!batch_lines.empty()) {
-                LogBatch batch{batch_id++, std::move(batch_lines)};
-                input_queue.push(std::move(batch));
-                total_batches.store(batch_id);
+                if (!batch.lines.empty()) {
+                    flush();
+                }
+
+                spdlog::info("Range {} finished: {} {}", i, lines,
+                             config_.logical_lines ? "records" : "lines");
+                range_results[i] = std::move(processed_batch.records);
+                worker_parsers[i] = std::move(parser);
+            } catch (const std::exception& e) {
+                spdlog::error("Error in worker task: {}", e.what());
             }
-        } else {
-            // Use a vector to collect lines in batches
-            std::vector<std::string> batch_lines;
-            batch_lines.reserve(current_batch_size_.load()); // Use adaptive batch size
-            size_t batch_id = 0;
-            size_t lines_processed = 0;
-            
-            read_file_by_chunks(config_.file_path, [&](const std::string& line) {
-                try {
-                    // Add to current batch
-                    batch_lines.push_back(line);
-                    lines_processed++;
-                    
-                    // If batch is full, push it to the queue
-                    size_t current_batch_size = current_batch_size_.load();
-                    if (batch_lines.size() >= current_batch_size) {
-                        LogBatch batch{batch_id++, std::move(batch_lines)};
-                        input_queue.push(std::move(batch));
-                        
-                        // Reset batch_lines for next batch
-                        batch_lines = std::vector<std::string>();
-                        batch_lines.reserve(current_batch_size);
-                        
-                        // Update total batches
-                        total_batches.store(batch_id);
-                        
-                        // Adjust batch size based on queue size and memory usage
-                        adjust_batch_size(input_queue);
-                        
-                        // If memory pressure is high, pause briefly to let consumers catch up
-                        if (memory_pressure_.load()) {
-                            size_t queue_size = input_queue.size();
-                            if (queue_size > queue_high_watermark_.load()) {
-                                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                            }
+        });
+    }
+    workers.wait();
+
+    // Concatenate in range order so records keep their file order
+    size_t total = 0;
+    for (const auto& records : range_results) {
+        total += records.size();
+    }
+    std::vector<LogRecordObject> results;
+    results.reserve(total);
+    std::vector<std::pair<size_t, size_t>> record_workers;
+    for (size_t i = 0; i < range_results.size(); i++) {
+        results.insert(results.end(),
+                       std::make_move_iterator(range_results[i].begin()),
+                       std::make_move_iterator(range_results[i].end()));
+        record_workers.emplace_back(results.size(), i);
+    }
+
+    auto* drain_parser = merge_drain_workers(worker_parsers, record_workers, results);
+    if (drain_parser && !drain_snapshot.empty() && !drain_parser->save_snapshot(drain_snapshot)) {
+        spdlog::warn("Could not write DRAIN snapshot {}", drain_snapshot);
+    }
+
+    running_ = false;
+    return results;
+}
+
+std::vector<LogRecordObject> FileDataLoader::load_data_gzip(size_t num_threads) {
+    auto mapping = std::make_shared<MemoryMappedFile>();
+    if (!mapping->open(config_.file_path)) {
+        throw std::runtime_error("Failed to map file: " + config_.file_path);
+    }
+    // The first load of a file pays one sequential pass to find checkpoints;
+    // later loads reuse the sidecar
+    GzipIndex index;
+    if (!index.open(config_.file_path, true, std::max<size_t>(config_.gzip_checkpoint_span_mb, 1) << 20)) {
+        throw std::runtime_error("Failed to index gzip file: " + config_.file_path);
+    }
+
+    std::vector<uint64_t> starts;
+    for (const auto& point : index.checkpoints()) {
+        starts.push_back(point.uncompressed_offset);
+    }
+    const auto regions = group_stream_regions(starts, index.uncompressed_size(), num_threads);
+    spdlog::info("Processing gzip file of {} bytes ({} uncompressed) in {} regions",
+                 mapping->size(), index.uncompressed_size(), regions.size());
+
+    const auto* data = reinterpret_cast<const unsigned char*>(mapping->data());
+    return parse_stream_regions(regions, [&](const StreamRegion& region, const auto& sink) {
+        return index.extract(data, mapping->size(), region.start, sink);
+    });
+}
+
+std::vector<LogRecordObject> FileDataLoader::load_data_zstd(size_t num_threads) {
+    auto mapping = std::make_shared<MemoryMappedFile>();
+    if (!mapping->open(config_.file_path)) {
+        throw std::runtime_error("Failed to map file: " + config_.file_path);
+    }
+    const auto* data = reinterpret_cast<const unsigned char*>(mapping->data());
+    ZstdIndex index;
+    if (!index.build(data, mapping->size())) {
+        throw std::runtime_error("Failed to read zstd frames: " + config_.file_path);
+    }
+
+    // Without every frame's decompressed size the region boundaries are
+    // unknown, so such files are decoded as one stream
+    std::vector<uint64_t> starts;
+    for (const auto& frame : index.frames()) {
+        starts.push_back(frame.uncompressed_offset);
+    }
+    const auto regions = index.sizes_known()
+        ? group_stream_regions(starts, index.uncompressed_size(), num_threads)
+        : std::vector<StreamRegion>{{0, 0, std::numeric_limits<uint64_t>::max()}};
+    spdlog::info("Processing zstd file of {} bytes ({} frames) in {} regions",
+                 mapping->size(), index.frames().size(), regions.size());
+
+    return parse_stream_regions(regions, [&](const StreamRegion& region, const auto& sink) {
+        return index.extract(data, mapping->size(), region.start, sink);
+    });
+}
+
+std::vector<FileDataLoader::StreamRegion> FileDataLoader::group_stream_regions(
+    const std::vector<uint64_t>& starts, uint64_t total, size_t parts) {
+    std::vector<StreamRegion> regions;
+    const size_t count = std::min(starts.size(), parts);
+    for (size_t r = 0; r < count; r++) {
+        size_t first = r * starts.size() / count;
+        size_t next = (r + 1) * starts.size() / count;
+        regions.push_back({first, starts[first], next < starts.size() ? starts[next] : total});
+    }
+    return regions;
+}
+
+std::vector<LogRecordObject> FileDataLoader::parse_stream_regions(
+    const std::vector<StreamRegion>& regions, const RegionDecoder& decode) {
+    running_ = true;
+
+    // A region [begin, end) of the decompressed text owns the lines that
+    // start after the first newline at or after `begin` (region 0 starts at
+    // 0) up to and including the line holding the first newline at or after
+    // `end`, so every line is parsed exactly once
+    std::vector<std::vector<LogRecordObject>> region_results(regions.size());
+    std::vector<std::unique_ptr<LogParser>> worker_parsers(regions.size());
+    TaskGroup workers;
+    for (size_t i = 0; i < regions.size(); i++) {
+        workers.run([this, &decode, &regions, &region_results, &worker_parsers, i]() {
+            try {
+                auto parser = create_parser();
+                if (!parser) {
+                    throw std::runtime_error("Failed to create parser in worker task");
+                }
+                auto* drain_parser = dynamic_cast<DrainParser*>(parser.get());
+                const size_t batch_size = std::max<size_t>(config_.batch_size, 1);
+                const StreamRegion& region = regions[i];
+                const bool last_region = i + 1 == regions.size();
+
+                LogBatch batch;
+                ProcessedBatch processed_batch;
+                processed_batch.worker = i;
+                auto flush = [&]() {
+                    processed_batch.id = batch.id;
+                    parse_batch_lines(*parser, drain_parser, batch, processed_batch);
+                    batch.lines.clear();
+                    batch.id++;
+                };
+
+                // Decompressed text not parsed yet; batches point into it, so
+                // they are flushed before it is trimmed
+                std::string pending;
+                uint64_t pending_offset = region.begin;
+                bool skip_partial = i > 0;
+                bool done = false;
+                size_t lines = 0;
+                auto consume = [&](bool at_eof) {
+                    size_t begin = 0;
+                    if (skip_partial) {
+                        size_t newline = pending.find('\n');
+                        if (newline == std::string::npos) {
+                            done = at_eof;
+                            pending_offset += pending.size();
+                            pending.clear();
+                            return;
                         }
+                        begin = newline + 1;
+                        skip_partial = false;
+                    }
+
+                    size_t stop = pending.size();
+                    size_t last_newline = std::string::npos;
+                    if (!last_region && pending_offset + pending.size() > region.end) {
+                        size_t from = region.end > pending_offset ? region.end - pending_offset : 0;
+                        last_newline = pending.find('\n', from);
                     }
-                    
-                    // Report progress periodically
-                    if (lines_processed % 10000 == 0) {
-                        spdlog::info("Processed {} lines", lines_processed);
+                    if (last_newline != std::string::npos) {
+                        // The skipped partial line already ran past the end
+                        stop = std::max(begin, last_newline + 1);
+                        done = true;
+                    } else if (!at_eof) {
+                        size_t newline = pending.rfind('\n');
+                        stop = newline != std::string::npos && newline >= begin ? newline + 1 : begin;
                     }
-                } catch (const std::exception& e) {
-                    spdlog::error("Error creating batch: {}", e.what());
+
+                    lines += for_each_line(pending.data() + begin, pending.data() + stop,
+                                           [&](std::string_view line) {
+                        batch.lines.push_back(line);
+                        if (batch.lines.size() >= batch_size) {
+                            flush();
+                        }
+                    });
+                    if (!batch.lines.empty()) {
+                        flush();
+                    }
+                    pending.erase(0, stop);
+                    pending_offset += stop;
+                };
+
+                bool ok = decode(region, [&](const char* chunk, size_t size) {
+                    pending.append(chunk, size);
+                    if (pending.size() >= kStreamParseChunk ||
+                        (!last_region && pending_offset + pending.size() > region.end)) {
+                        consume(false);
+                    }
+                    return !done;
+                });
+                if (!ok) {
+                    spdlog::error("Corrupt compressed data in region {} of {}", i, config_.file_path);
                 }
-            });
-            
-            // Push any remaining lines
-            if (!batch_lines.empty()) {
-                LogBatch batch{batch_id++, std::move(batch_lines)};
-                input_queue.push(std::move(batch));
-                total_batches.store(batch_id);
+                if (!done) {
+                    consume(true);
+                }
+
+                spdlog::info("Region {} finished: {} lines", i, lines);
+                region_results[i] = std::move(processed_batch.records);
+                worker_parsers[i] = std::move(parser);
+            } catch (const std::exception& e) {
+                spdlog::error("Error in worker task: {}", e.what());
             }
-        }
-    } catch (const std::exception& e) {
-        spdlog::error("Error in producer thread: {}", e.what());
+        });
     }
-    
-    // Signal that no more batches will be produced
-    input_queue.done();
-}
+    workers.wait();
 
-void FileDataLoader::read_file_by_chunks(const std::string& filepath, 
-                                       const std::function<void(const std::string&)>& callback) {
-    std::ifstream file(filepath);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + filepath);
+    size_t total = 0;
+    for (const auto& records : region_results) {
+        total += records.size();
     }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            callback(line);
-        }
+    std::vector<LogRecordObject> results;
+    results.reserve(total);
+    std::vector<std::pair<size_t, size_t>> record_workers;
+    for (size_t i = 0; i < region_results.size(); i++) {
+        results.insert(results.end(),
+                       std::make_move_iterator(region_results[i].begin()),
+                       std::make_move_iterator(region_results[i].end()));
+        record_workers.emplace_back(results.size(), i);
     }
+
+    merge_drain_workers(worker_parsers, record_workers, results);
+
+    running_ = false;
+    return results;
 }
 
-void FileDataLoader::read_file_memory_mapped(const std::string& file_path, 
-                                           std::function<void(std::string_view)> line_processor) {
-    try {
-        // Open the file
-        int fd = open(file_path.c_str(), O_RDONLY);
-        if (fd == -1) {
-            throw std::runtime_error("Failed to open file: " + file_path + ", error: " + strerror(errno));
-        }
+DrainParser* FileDataLoader::merge_drain_workers(std::vector<std::unique_ptr<LogParser>>& worker_parsers,
+                                                 const std::vector<std::pair<size_t, size_t>>& record_workers,
+                                                 std::vector<LogRecordObject>& results) {
+    // Every worker learned its own DRAIN state, so the same cluster ID means
+    // different templates in different workers. Fold them into the first
+    // worker's parser, in worker order so the remapping is deterministic. A
+    // worker whose task failed before creating its parser left no records.
+    std::vector<DrainParser*> drains;
+    for (auto& parser : worker_parsers) {
+        drains.push_back(dynamic_cast<DrainParser*>(parser.get()));
+    }
+    auto first = std::find_if(drains.begin(), drains.end(), [](DrainParser* drain) { return drain != nullptr; });
+    if (first == drains.end()) {
+        return nullptr;
+    }
+    const size_t base = first - drains.begin();
 
-        // Get file size
-        struct stat sb;
-        if (fstat(fd, &sb) == -1) {
-            close(fd);
-            throw std::runtime_error("Failed to get file size: " + file_path + ", error: " + strerror(errno));
+    std::vector<folly::F14FastMap<int, int>> remaps(drains.size());
+    for (size_t w = base + 1; w < drains.size(); ++w) {
+        if (drains[w]) {
+            remaps[w] = drains[base]->merge(*drains[w]);
         }
+    }
 
-        // Map the file into memory
-        void* mapped = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-        if (mapped == MAP_FAILED) {
-            close(fd);
-            throw std::runtime_error("Failed to map file: " + file_path + ", error: " + strerror(errno));
+    // Merging can widen templates, so refresh them for the base worker's records too
+    const auto templates = drains[base]->get_all_templates();
+    size_t begin = 0;
+    for (const auto& [end, worker] : record_workers) {
+        for (size_t i = begin; i < end; ++i) {
+            auto& record = results[i];
+            auto it = record.fields.find("cluster_id");
+            if (it == record.fields.end()) {
+                continue;
+            }
+            int cluster_id = std::stoi(it->second.toStdString());
+            if (worker != base) {
+                auto mapped = remaps[worker].find(cluster_id);
+                if (mapped != remaps[worker].end()) {
+                    cluster_id = mapped->second;
+                    it->second = std::to_string(cluster_id);
+                }
+            }
+            auto tmpl = templates.find(cluster_id);
+            if (tmpl != templates.end()) {
+                record.template_str = tmpl->second;
+            }
         }
+        begin = end;
+    }
+    // Merging leaves eviction to us so the remap stayed valid until now
+    drains[base]->enforce_max_clusters();
+    return drains[base];
+}
 
-        // Process the file line by line
-        const char* data = static_cast<const char*>(mapped);
-        const char* end = data + sb.st_size;
-        const char* line_start = data;
+std::unique_ptr<LogParser> FileDataLoader::create_parser() {
+    if (config_.log_type == "csv") {
+        return std::make_unique<CsvParser>(config_);
+    } else if (config_.log_type == "json") {
+        return std::make_unique<JsonParser>(config_);
+    } else if (config_.log_type == "drain") {
+        // Use the high-performance DRAIN parser for log pattern parsing
+        return std::make_unique<DrainParser>(config_);
+    } else {
+        // Default to regex parser for custom log formats
+        return std::make_unique<RegexParser>(config_, config_.log_pattern);
+    }
+}
 
-        spdlog::info("Processing memory mapped file of size: {} bytes", sb.st_size);
+std::vector<std::unique_ptr<LogParser>> FileDataLoader::parse_batches(
+    const std::function<void(ProcessedBatch&)>& on_batch, bool shared_drain, size_t budget_bytes) {
+    ParserSet parsers([this]() { return create_parser(); }, shared_drain && config_.log_type == "drain");
+    TaskGroup tasks;
+    TaskGroup reader;
 
-        // Process each line
-        size_t line_count = 0;
-        while (line_start < end) {
-            // Find the end of the current line
-            const char* line_end = line_start;
-            while (line_end < end && *line_end != '\n') {
-                ++line_end;
+    // Bytes of raw batches and parsed records between reading and delivery.
+    // Without an explicit budget, allow half of the container's memory.
+    if (budget_bytes == 0) {
+        budget_bytes = MemoryBudget::cgroup_limit() / 2;
+    }
+    MemoryBudget budget(budget_bytes);
+    if (budget.limit() > 0) {
+        spdlog::info("Ingestion memory budget: {} MB", budget.limit() >> 20);
+    }
+
+    // Parsed batches come back through a window of queue_capacity slots;
+    // reading pauses (running pool tasks meanwhile) while the oldest
+    // undelivered batch is that far behind
+    ReorderBuffer<ProcessedBatch> ordered(std::max<size_t>(config_.queue_capacity, 1));
+
+    reader.run([&]() {
+        size_t produced = 0;
+        // Waiting threads only help with parse tasks, never unrelated pool work
+        auto help = [&tasks]() { return tasks.run_one(); };
+        produce_batches([&](LogBatch&& batch) {
+            if (!ordered.wait_for_room(batch.id, help)) {
+                throw std::runtime_error("Batch delivery stopped");
+            }
+            const size_t batch_bytes = approximate_bytes(batch);
+            budget.acquire(batch_bytes, help);
+            if (batch.id % 64 == 0) {
+                // Close to the container limit: keep each unit of work small
+                // until a later check finds the pressure gone
+                if (detect_memory_pressure()) {
+                    pressure_batch_cap_.store(min_batch_size_.load());
+                    current_batch_size_.store(min_batch_size_.load());
+                } else {
+                    pressure_batch_cap_.store(0);
+                }
             }
 
-            // Create a string_view for the current line
-            size_t line_length = line_end - line_start;
-            if (line_length > 0 && line_length < MAX_LINE_LENGTH) {
+            auto shared_batch = std::make_shared<LogBatch>(std::move(batch));
+            tasks.run([this, &parsers, &ordered, &budget, shared_batch, batch_bytes]() {
+                ProcessedBatch processed_batch;
+                processed_batch.id = shared_batch->id;
+                std::optional<size_t> borrowed;
                 try {
-                    std::string_view line(line_start, line_length);
-                    line_processor(line);
-                    line_count++;
-                    
-                    if (line_count % 10000 == 0) {
-                        spdlog::info("Processed {} lines", line_count);
-                    }
+                    auto [index, parser] = parsers.acquire();
+                    borrowed = index;
+                    processed_batch.worker = index;
+                    processed_batch.records.reserve(shared_batch->lines.size());
+                    // DRAIN can match a whole batch with far less locking than line by line
+                    auto start = std::chrono::steady_clock::now();
+                    parse_batch_lines(*parser, dynamic_cast<DrainParser*>(parser), *shared_batch, processed_batch);
+                    record_batch_latency(shared_batch->lines.size(), std::chrono::steady_clock::now() - start);
                 } catch (const std::exception& e) {
-                    spdlog::error("Error processing line: {}", e.what());
+                    spdlog::error("Error in worker task: {}", e.what());
+                    processed_batch.records.clear();
                 }
-            } else if (line_length >= MAX_LINE_LENGTH) {
-                spdlog::error("Skipping line {} (length: {}): Line too long", line_count, line_length);
-            }
+                // Hand the parser back even after a failure, so the next
+                // task reuses it instead of creating another
+                if (borrowed) {
+                    parsers.release(*borrowed);
+                }
+                // Swap the raw lines' charge for the records'; a task never
+                // blocks on the budget, only the reader does
+                processed_batch.bytes = approximate_bytes(processed_batch.records);
+                budget.add(processed_batch.bytes);
+                budget.release(batch_bytes);
+
+                // Deliver even a failed batch so later ones are not held back
+                size_t id = processed_batch.id;
+                ordered.put(id, std::move(processed_batch));
+            });
+            produced = shared_batch->id + 1;
+            adjust_batch_size(produced - ordered.next());
+        }, help);
+        ordered.finish(produced);
+    });
+
+    // Hand batches over in file order, each as soon as it and every batch
+    // before it are parsed
+    try {
+        ProcessedBatch batch;
+        while (ordered.pop(batch)) {
+            on_batch(batch);
+            budget.release(batch.bytes);
+        }
+    } catch (...) {
+        ordered.cancel();
+        reader.wait();
+        tasks.wait();
+        throw;
+    }
 
-            // Move to the next line
-            line_start = (line_end < end) ? line_end + 1 : end;
+    reader.wait();
+    tasks.wait();
+    return parsers.take();
+}
+
+void FileDataLoader::parse_batch_lines(LogParser& parser, DrainParser* drain_parser,
+                                       const LogBatch& batch, ProcessedBatch& processed_batch) {
+    size_t success_count = 0;
+    size_t error_count = 0;
+    
+    if (drain_parser) {
+        // Batches never hold empty lines, so the views are passed through
+        // as they are
+        const std::vector<std::string_view>& lines = batch.lines;
+        try {
+            drain_parser->parse_batch(
+                folly::Range<const std::string_view*>(lines.data(), lines.size()),
+                processed_batch.records);
+            success_count = lines.size();
+        } catch (const std::exception& e) {
+            error_count = lines.size();
+            spdlog::error("Error parsing batch {}: {}", batch.id, e.what());
+        }
+    } else {
+        std::string line;
+        for (std::string_view line_view : batch.lines) {
+            try {
+                if (!line_view.empty()) {
+                    line.assign(line_view.data(), line_view.size());
+                    auto record = parser.parse_line(line);
+                    processed_batch.records.push_back(std::move(record));
+                    success_count++;
+                }
+            } catch (const std::exception& e) {
+                error_count++;
+                if (error_count < 10) { // Limit error messages to avoid flooding logs
+                    spdlog::error("Error parsing line: {}", e.what());
+                    if (line.length() < 200) { // Only print short lines to avoid flooding logs
+                        spdlog::error("Line content: {}", line);
+                    } else {
+                        spdlog::error("Line too long to display ({} chars)", line.length());
+                    }
+                } else if (error_count == 10) {
+                    spdlog::warn("Too many parsing errors, suppressing further messages...");
+                }
+            }
         }
+    }
+    
+    if (batch.id % 10 == 0 || error_count > 0) {
+        spdlog::info("Processed batch {}: {} successes, {} errors", 
+                    batch.id, success_count, error_count);
+    }
+}
+
+void FileDataLoader::produce_batches(const std::function<void(LogBatch&&)>& emit,
+                                     const std::function<bool()>& help) {
+    try {
+        LogBatch batch_lines;
+        batch_lines.lines.reserve(current_batch_size_.load()); // Use adaptive batch size
+        size_t batch_id = 0;
+        size_t lines_processed = 0;
+
+        auto push_batch = [&]() {
+            batch_lines.id = batch_id++;
+            batch_lines.finalize();
+            emit(std::move(batch_lines));
+
+            // Reset batch_lines for next batch
+            batch_lines = LogBatch();
+            batch_lines.lines.reserve(current_batch_size_.load());
+        };
+
+        auto line_added = [&]() {
+            lines_processed++;
+
+            // If batch is full, hand it off
+            if (batch_lines.size() >= current_batch_size_.load()) {
+                push_batch();
+            }
+
+            // Report progress periodically
+            if (lines_processed % 10000 == 0) {
+                spdlog::info("Processed {} lines", lines_processed);
+            }
+        };
 
-        spdlog::info("Finished processing {} lines", line_count);
+        // Add a view of a line held in `source`
+        auto add_line = [&](std::string_view line, const std::shared_ptr<const void>& source) {
+            if (batch_lines.sources.empty() || batch_lines.sources.back() != source) {
+                batch_lines.sources.push_back(source);
+            }
+            batch_lines.lines.push_back(line);
+            line_added();
+        };
+
+        // Batches point straight into mapped windows or read buffers and
+        // keep them alive; only a line split across two blocks is copied
+        BlockLineSplitter splitter(add_line);
+        auto on_block = [&](const std::shared_ptr<const char>& block, size_t size) {
+            splitter.add(block, size);
+        };
+        // With every window or buffer held, hand on the batch being built so
+        // the blocks it points into get parsed and released
+        auto idle = [&]() {
+            if (batch_lines.size() > 0) {
+                push_batch();
+                return true;
+            }
+            return help();
+        };
+
+        bool ok = false;
+        if (config_.use_memory_mapping) {
+            MappedWindowReader reader(mapped_window_options());
+            ok = reader.read(config_.file_path, on_block, idle);
+        } else {
+            UringFileReader::Options options;
+            options.block_size = config_.read_block_size;
+            options.queue_depth = config_.read_queue_depth;
+            UringFileReader reader(options);
+            ok = reader.read(config_.file_path, on_block, idle);
+        }
+        if (!ok) {
+            throw std::runtime_error("Failed to read file: " + config_.file_path);
+        }
+        splitter.finish();
 
-        // Unmap and close the file
-        if (munmap(mapped, sb.st_size) == -1) {
-            spdlog::error("Warning: Failed to unmap file: {}", file_path);
+        // Push any remaining lines
+        if (batch_lines.size() > 0) {
+            push_batch();
         }
-        close(fd);
     } catch (const std::exception& e) {
-        spdlog::error("Error in read_file_memory_mapped: {}", e.what());
-        throw;
+        spdlog::error("Error reading batches: {}", e.what());
+    }
+}
+
+size_t FileDataLoader::get_current_memory_usage() const {
+    size_t usage = MemoryBudget::cgroup_usage();
+    return usage > 0 ? usage : MemoryBudget::resident_bytes();
+}
+
+bool FileDataLoader::detect_memory_pressure() const {
+    size_t limit = MemoryBudget::cgroup_limit();
+    return limit > 0 && get_current_memory_usage() > limit / 10 * 9;
+}
+
+void FileDataLoader::record_batch_latency(size_t lines, std::chrono::nanoseconds elapsed) {
+    if (lines == 0) {
+        return;
+    }
+    last_batch_latency_ns_.store(elapsed.count());
+    batches_timed_.fetch_add(1);
+
+    // Exponentially weighted average of the per-line cost, so one odd
+    // batch does not swing the size
+    const double sample = static_cast<double>(elapsed.count()) / lines;
+    double average = ns_per_line_.load();
+    double updated;
+    do {
+        updated = average == 0.0 ? sample : average + 0.2 * (sample - average);
+    } while (!ns_per_line_.compare_exchange_weak(average, updated));
+}
+
+void FileDataLoader::adjust_batch_size(size_t queue_size) {
+    const size_t min_size = min_batch_size_.load();
+    size_t max_size = max_batch_size_.load();
+    const size_t batch_size = current_batch_size_.load();
+    if (const size_t cap = pressure_batch_cap_.load(); cap > 0) {
+        max_size = std::min(max_size, cap);
     }
+
+    // Size batches so one takes about the target time to parse
+    double target = static_cast<double>(batch_size);
+    const double ns_per_line = ns_per_line_.load();
+    if (ns_per_line > 0.0) {
+        target = config_.target_batch_latency_us * 1000.0 / ns_per_line;
+    }
+
+    // Deep backlog: workers are behind, so amortize more per task.
+    // Shallow backlog: workers are starving, so split work finer.
+    if (queue_size > queue_high_watermark_.load()) {
+        target *= 2;
+    } else if (queue_size < queue_low_watermark_.load()) {
+        target /= 2;
+    }
+
+    // Move at most 2x per step toward the target
+    target = std::min(target, batch_size * 2.0);
+    target = std::max(target, batch_size / 2.0);
+    size_t next = static_cast<size_t>(target);
+    current_batch_size_.store(std::clamp(next, min_size, std::max(min_size, max_size)));
+}
+
+BatchSizingStats FileDataLoader::get_batch_stats() const {
+    BatchSizingStats stats;
+    stats.batch_size = current_batch_size_.load();
+    stats.ns_per_line = ns_per_line_.load();
+    stats.last_batch_ms = last_batch_latency_ns_.load() / 1e6;
+    stats.batches_parsed = batches_timed_.load();
+    return stats;
+}
+
+MappedWindowReader::Options FileDataLoader::mapped_window_options() const {
+    MappedWindowReader::Options options;
+    options.window_size = config_.mmap_window_mb << 20;
+    options.huge_pages = config_.mmap_huge_pages;
+    return options;
 }
 
 std::vector<LogRecordObject> FileDataLoader::read_logs(const std::string& filepath) {
@@ -753,11 +1462,9 @@ void FileDataLoader::process_batch(const LogBatch& batch, ProcessedBatch& result
     result.records.reserve(batch.lines.size());
     
     // Apply preprocessing if enabled
-    std::vector<std::string> preprocessed_lines;
+    std::vector<std::string> preprocessed_lines(batch.lines.begin(), batch.lines.end());
     if (config_.enable_preprocessing) {
-        preprocessed_lines = preprocess_logs(batch.lines);
-    } else {
-        preprocessed_lines = batch.lines;
+        preprocessed_lines = preprocess_logs(preprocessed_lines);
     }
     
     // Parse each line
@@ -796,6 +1503,12 @@ std::vector<LogRecordObject> FileDataLoader::parse_log_file(const std::string& f
             setFormat(format);
         }
         
+        // Resume from the file's checkpoint and parse only what was appended
+        if (config_.incremental) {
+            config_.file_path = filepath;
+            return load_data();
+        }
+        
         // Load and parse the log data
         return read_logs(filepath);
     }
@@ -837,84 +1550,17 @@ bool FileDataLoader::process_large_file_with_callback(
             return false;
         }
         
-        // For large files, process in chunks
-        MemoryMappedFile mmapped_file(input_file);
-        if (!mmapped_file.isOpen()) {
-            spdlog::error("Failed to memory map file: {}", input_file);
-            return false;
-        }
-        
-        // Process file in chunks using producer-consumer pattern
-        const size_t line_estimate = chunk_size;
-        std::atomic<size_t> total_batches{0};
-        ThreadSafeQueue<LogBatch> input_queue;
-        ThreadSafeQueue<ProcessedBatch> output_queue;
-        
-        // Start producer thread to read file
-        std::thread producer([this, &mmapped_file, &input_queue, &total_batches, line_estimate]() {
-            producer_thread(mmapped_file, input_queue, total_batches);
-        });
-        
-        // Start worker threads to process batches
-        const size_t num_workers = std::thread::hardware_concurrency();
-        std::vector<std::thread> workers;
-        for (size_t i = 0; i < num_workers; i++) {
-            workers.emplace_back([this, &input_queue, &output_queue]() {
-                worker_thread(input_queue, output_queue);
-            });
-        }
-        
-        // Process output batches as they become available
-        std::thread consumer([this, &output_queue, &callback, num_workers, &total_batches]() {
-            // Process batches in order
-            std::map<size_t, ProcessedBatch> pending_batches;
-            size_t next_batch_id = 0;
-            
-            while (true) {
-                // Check if we're done
-                if (output_queue.empty() && total_batches.load() > 0 && 
-                    next_batch_id >= total_batches.load()) {
-                    break;
-                }
-                
-                // Get next batch
-                ProcessedBatch batch;
-                if (!output_queue.try_pop(batch)) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                    continue;
-                }
-                
-                // Store batch for later if it's not the next one
-                if (batch.id != next_batch_id) {
-                    pending_batches[batch.id] = std::move(batch);
-                    continue;
-                }
-                
-                // Process this batch and any pending batches that are now ready
-                do {
-                    // Process the current batch
-                    callback(batch.records);
-                    next_batch_id++;
-                    
-                    // Check if the next batch is in pending
-                    auto it = pending_batches.find(next_batch_id);
-                    if (it == pending_batches.end()) {
-                        break;
-                    }
-                    
-                    // Process the pending batch
-                    batch = std::move(it->second);
-                    pending_batches.erase(it);
-                } while (true);
-            }
-        });
+        // For large files, process in chunks; the reader maps or reads the
+        // file a window at a time
+        config_.file_path = input_file;
         
-        // Wait for all threads to finish
-        producer.join();
-        for (auto& worker : workers) {
-            worker.join();
-        }
-        consumer.join();
+        // Parse batches on the shared thread pool; they come back to this
+        // thread in file order. Each is delivered as soon as it is parsed,
+        // before per-worker DRAIN states could be merged, so all tasks share
+        // one thread-safe DRAIN parser and cluster IDs agree from the start.
+        parse_batches([&callback](ProcessedBatch& batch) {
+            callback(batch.records);
+        }, true, memory_limit_mb << 20);
         
         return true;
     }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <mutex>
 #include <thread>
 #include <functional>
 #include <filesystem>
@@ -13,12 +16,16 @@
 #include "data_loader_config.h"
 #include "log_record.h"
 #include "memory_mapped_file.h"
-#include "thread_safe_queue.h"
+#include "line_index.h"
+#include "mapped_window_reader.h"
+#include "multiline_detector.h"
 #include "log_parser.h"
 #include "preprocessor.h"
 
 namespace logai {
 
+class DrainParser;
+
 /**
  * @brief Configuration for file data loader
  */
@@ -26,7 +33,11 @@ struct FileDataLoaderConfig : public DataLoaderConfig {
     std::string encoding = "utf-8";
     std::string delimiter = ",";
     bool has_header = true;
+    // Assemble multi-line records (stack traces, continued lines) before
+    // parsing; see MultilineRules
     bool logical_lines = false;
+    std::string record_start_pattern = "";
+    bool record_timestamp_start = false;
     bool decompress = false;
     bool enable_preprocessing = false;
     size_t buffer_size = 8192;
@@ -36,14 +47,71 @@ struct FileDataLoaderConfig : public DataLoaderConfig {
     std::string log_pattern = "";
     size_t num_threads = 0;
     bool use_memory_mapping = true;
+    // With memory mapping, give each worker its own newline-aligned byte
+    // range of the file instead of feeding all workers from one producer
+    bool split_byte_ranges = false;
+    // Resume from the checkpoint an earlier load_data() left next to the
+    // file (see IngestCheckpoint) and parse only the lines appended since;
+    // a rotated or rewritten file is parsed from the start. Memory mapped,
+    // uncompressed files only.
+    bool incremental = false;
+    // Batches read but not yet delivered; reading pauses when reached
+    size_t queue_capacity = 256;
+    // Bytes of batches and records in flight; reading pauses when reached.
+    // 0 = half the cgroup memory limit (unbounded outside a limited cgroup).
+    // Only data between reading and delivery is bounded: the records
+    // load_data() accumulates for its result grow with the file, so use
+    // process_large_file_with_callback() when the output must fit too.
+    size_t memory_budget_mb = 0;
+    // Batch sizes are tuned so parsing one batch takes about this long
+    size_t target_batch_latency_us = 3000;
+    // Sequential reads map the file this many MB at a time, releasing
+    // windows behind the cursor, so page cache use stays bounded
+    size_t mmap_window_mb = 64;
+    bool mmap_huge_pages = false;
+    // Without memory mapping: bytes per read and reads kept in flight
+    size_t read_block_size = 1 << 20;
+    size_t read_queue_depth = 8;
+    // Decompressed bytes between checkpoints of a .gz file's index, which
+    // bound how finely it can be split across workers
+    size_t gzip_checkpoint_span_mb = 4;
+};
+
+/**
+ * @brief State of the adaptive batch size controller
+ */
+struct BatchSizingStats {
+    size_t batch_size = 0;       // Lines per batch currently chosen
+    double ns_per_line = 0.0;    // Smoothed parse cost per line
+    double last_batch_ms = 0.0;  // Parse time of the most recent batch
+    size_t batches_parsed = 0;
 };
 
 /**
  * @brief Batch of log lines for parallel processing
  */
 struct LogBatch {
-    size_t id;
-    std::vector<std::string> lines;
+    size_t id = 0;
+    // Lines to parse. They point into `sources` (the file mapping, or
+    // buffers filled by UringFileReader) or into `owned`.
+    std::vector<std::string_view> lines;
+    // Keeps what `lines` point into alive for as long as the batch exists
+    std::vector<std::shared_ptr<const void>> sources;
+    std::vector<std::string> owned;
+
+    size_t size() const {
+        return owned.empty() ? lines.size() : owned.size();
+    }
+
+    /**
+     * Point `lines` at `owned` once no more lines will be appended to it
+     * (appending may move short strings' inline buffers).
+     */
+    void finalize() {
+        if (!owned.empty()) {
+            lines.assign(owned.begin(), owned.end());
+        }
+    }
 };
 
 /**
@@ -52,6 +120,8 @@ struct LogBatch {
 struct ProcessedBatch {
     size_t id;
     std::vector<LogRecordObject> records;
+    size_t worker = 0;  // Index of the parser that parsed the batch
+    size_t bytes = 0;   // Approximate heap bytes of `records`, for the memory budget
 };
 
 /**
@@ -82,12 +152,23 @@ public:
     void processInChunks(size_t chunk_size, 
         const std::function<void(const std::vector<LogParser::LogEntry>&)>& callback);
 
+    // Parse the whole file; the result holds every record (see memory_budget_mb)
     std::vector<LogRecordObject> load_data();
     double get_progress() const;
+
+    /**
+     * @brief Batch size chosen by the adaptive controller and the parse
+     * timings it is based on
+     */
+    BatchSizingStats get_batch_stats() const;
     
     /**
      * @brief Parse a log file and return the parsed records
-     * 
+     *
+     * With `incremental` set, only the records appended since the previous
+     * call on the same file are returned, for the caller to append to the
+     * ones it already has.
+     *
      * @param filepath The path to the log file
      * @param format The format of the log file (e.g., "json", "csv", "syslog")
      * @return std::vector<LogRecordObject> Vector of parsed log records
@@ -133,10 +214,31 @@ public:
     // Process a single batch of log lines
     void process_batch(const LogBatch& batch, ProcessedBatch& result);
 
+    /**
+     * @brief Read raw lines by position without parsing the whole file
+     * 
+     * The first call maps the file and loads (or builds and persists) its
+     * line index sidecar; later calls are a lookup per line.
+     * 
+     * @param start Zero-based index of the first line
+     * @param count Maximum number of lines to return
+     * @return std::vector<std::string> The lines, fewer if the file ends first
+     */
+    std::vector<std::string> read_lines(size_t start, size_t count);
+
+    /**
+     * @brief Number of lines in the file, using the same index as read_lines
+     */
+    size_t line_count();
+
 private:
     std::string filepath_;
     FileDataLoaderConfig config_;
     std::unique_ptr<std::istream> input_stream_;
+    // Line read past the end of a logical line, returned by the next readLine()
+    std::string lookahead_;
+    bool has_lookahead_ = false;
+    std::unique_ptr<MultilineDetector> line_detector_;
     std::unique_ptr<LogParser> parser_;
 
     // Initialize input stream based on file type
@@ -150,9 +252,9 @@ private:
 
     // Handle logical lines
     std::string readLogicalLine();
-    bool isLogicalLineContinuation(const std::string& line);
-    std::string handleIndentationContinuation(const std::string& line, std::string& current_line);
-    std::string handleBackslashContinuation(const std::string& line, std::string& current_line);
+    bool readLine(std::string& line);
+    bool hasMoreInput() const;
+    MultilineRules multiline_rules() const;
 
     // Utility functions
     bool isCompressedFile() const;
@@ -171,16 +273,20 @@ private:
     
     // Adaptive batch sizing parameters
     std::atomic<size_t> current_batch_size_{100};  // Default batch size
-    std::atomic<size_t> max_batch_size_{1000};     // Maximum batch size
+    std::atomic<size_t> max_batch_size_{100000};   // Maximum batch size
     std::atomic<size_t> min_batch_size_{10};       // Minimum batch size
-    std::atomic<size_t> queue_high_watermark_{200}; // Queue size to trigger batch size reduction
-    std::atomic<size_t> queue_low_watermark_{10};   // Queue size to trigger batch size increase
-    std::atomic<bool> memory_pressure_{false};      // Flag for memory pressure detection
+    std::atomic<size_t> pressure_batch_cap_{0};    // Batch size ceiling while memory is tight (0 = none)
+    std::atomic<size_t> queue_high_watermark_{200}; // Queue size to trigger batch size increase
+    std::atomic<size_t> queue_low_watermark_{10};   // Queue size to trigger batch size reduction
+    std::atomic<double> ns_per_line_{0.0};          // Smoothed parse cost per line
+    std::atomic<int64_t> last_batch_latency_ns_{0};
+    std::atomic<size_t> batches_timed_{0};
     
-    // Multi-threading components
-    ThreadSafeQueue<LogBatch> batch_queue_;
-    ThreadSafeQueue<ProcessedBatch> processed_queue_;
-    std::vector<std::thread> worker_threads_;
+    // Line index for read_lines (built on first use, rebuilt when the file changes)
+    std::mutex line_index_mutex_;
+    std::unique_ptr<LineIndex> line_index_;
+    std::unique_ptr<MemoryMappedFile> line_file_;
+    bool ensure_line_index();
     
     std::vector<LogRecordObject> read_logs(const std::string& filepath);
     std::vector<LogRecordObject> read_csv(const std::string& filepath);
@@ -194,22 +300,59 @@ private:
     std::vector<std::string> simd_parse_csv_line(const std::string& line, char delimiter);
     bool simd_pattern_search(const std::string& line, const std::string& pattern);
     
-    void read_file_by_chunks(
-        const std::string& filepath, 
-        const std::function<void(const std::string&)>& callback);
-    
-    void read_file_memory_mapped(
-        const std::string& filepath,
-        std::function<void(std::string_view)> callback);
+    MappedWindowReader::Options mapped_window_options() const;
     
-    void reader_thread(const std::string& filepath);
-    void worker_thread(ThreadSafeQueue<LogBatch>& input_queue, ThreadSafeQueue<ProcessedBatch>& output_queue);
-    void collector_thread();
+    void parse_batch_lines(LogParser& parser, DrainParser* drain_parser,
+                           const LogBatch& batch, ProcessedBatch& processed_batch);
     
     ProcessedBatch process_batch(const LogBatch& batch, const std::string& log_format = "");
     std::unique_ptr<LogParser> create_parser();
-    void producer_thread(MemoryMappedFile& file, ThreadSafeQueue<LogBatch>& input_queue, std::atomic<size_t>& total_batches);
-    void consumer_thread(size_t num_threads, ThreadSafeQueue<ProcessedBatch>& output_queue, std::vector<LogRecordObject>& results, std::atomic<size_t>& total_batches);
+    // help() runs queued work while every read block is held
+    void produce_batches(const std::function<void(LogBatch&&)>& emit,
+                         const std::function<bool()>& help);
+    // Parse every batch on the shared thread pool, calling on_batch on this
+    // thread in file order; returns the parsers used (see ProcessedBatch::worker)
+    // (budget_bytes = 0: half the cgroup memory limit, if any). With
+    // `shared_drain`, every task matches against one DRAIN parser, so cluster
+    // IDs agree before the parsers could be merged.
+    std::vector<std::unique_ptr<LogParser>> parse_batches(
+        const std::function<void(ProcessedBatch&)>& on_batch, bool shared_drain, size_t budget_bytes = 0);
+    std::vector<LogRecordObject> load_data_split(size_t num_threads);
+    // Parse only what was appended since the file's IngestCheckpoint
+    std::vector<LogRecordObject> load_data_incremental(size_t num_threads);
+    uint64_t settings_fingerprint() const;
+    // Parse the lines in [begin, end) of a mapped file, one newline-aligned
+    // range per task, records in file order. Worker 0 parses with
+    // `first_parser` if given (e.g. DRAIN state loaded from a snapshot).
+    // With `drain_snapshot`, the merged DRAIN state is written to that file.
+    std::vector<LogRecordObject> parse_mapped_range(const std::shared_ptr<MemoryMappedFile>& mapping,
+                                                    uint64_t begin, uint64_t end, size_t num_threads,
+                                                    const std::string& drain_snapshot = "",
+                                                    std::unique_ptr<LogParser> first_parser = nullptr);
+    // Decompress and parse regions of a .gz file in parallel from GzipIndex checkpoints
+    std::vector<LogRecordObject> load_data_gzip(size_t num_threads);
+    // Decompress and parse runs of independent .zst frames in parallel
+    std::vector<LogRecordObject> load_data_zstd(size_t num_threads);
+
+    // Part of a compressed file that decodes on its own from checkpoint or
+    // frame `start`; [begin, end) are offsets in the decompressed text
+    struct StreamRegion {
+        size_t start;
+        uint64_t begin;
+        uint64_t end;
+    };
+    using RegionDecoder = std::function<bool(const StreamRegion&,
+                                             const std::function<bool(const char*, size_t)>&)>;
+    // Split decodable starting points into at most `parts` regions
+    static std::vector<StreamRegion> group_stream_regions(const std::vector<uint64_t>& starts,
+                                                          uint64_t total, size_t parts);
+    // Decode and parse every region on the shared thread pool, records in file order
+    std::vector<LogRecordObject> parse_stream_regions(const std::vector<StreamRegion>& regions,
+                                                      const RegionDecoder& decode);
+    // Returns the DRAIN parser the others were merged into, if any
+    DrainParser* merge_drain_workers(std::vector<std::unique_ptr<LogParser>>& worker_parsers,
+                                     const std::vector<std::pair<size_t, size_t>>& record_workers,
+                                     std::vector<LogRecordObject>& results);
 
     // Read file line by line with callback
     void read_file_line_by_line(const std::string& filepath, 
@@ -217,7 +360,8 @@ private:
                                
     // Memory monitoring functions
     size_t get_current_memory_usage() const;
-    void adjust_batch_size(ThreadSafeQueue<LogBatch>& queue);
+    void record_batch_latency(size_t lines, std::chrono::nanoseconds elapsed);
+    void adjust_batch_size(size_t queue_size);
     bool detect_memory_pressure() const;
     void process_in_chunks(const std::string& filepath, size_t chunk_size, const std::string& output_dir);
     
@@ -0,0 +1,482 @@
+#include "file_follower.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+
+namespace {
+
+constexpr char kCheckpointMagic[8] = {'L', 'O', 'G', 'A', 'I', 'F', 'C', 'K'};
+constexpr uint32_t kCheckpointVersion = 1;
+constexpr size_t kReadChunk = 1 << 20;
+// A line that grows past this without a newline is delivered in pieces
+constexpr size_t kMaxLineLength = 1024 * 1024;
+
+constexpr uint32_t kFileEvents = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+constexpr uint32_t kDirectoryEvents = IN_CREATE | IN_MOVED_TO;
+
+template <typename T>
+void append_value(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void append_string(std::string& out, const std::string& value) {
+    append_value(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+// Reads fixed-size fields and strings from a checkpoint, failing once the
+// data runs out
+class CheckpointReader {
+public:
+    explicit CheckpointReader(const std::string& data) : data_(data) {}
+
+    template <typename T>
+    bool value(T& out) {
+        if (data_.size() - pos_ < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&out, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool string(std::string& out) {
+        uint32_t size = 0;
+        if (!value(size) || data_.size() - pos_ < size) {
+            return false;
+        }
+        out.assign(data_, pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+private:
+    const std::string& data_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+FileFollower::FileFollower(std::string checkpoint_path, Options options)
+    : checkpoint_path_(std::move(checkpoint_path)), options_(options) {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        spdlog::warn("inotify unavailable ({}), following files by polling", std::strerror(errno));
+    }
+    if (!checkpoint_path_.empty()) {
+        load_checkpoint();
+    }
+}
+
+FileFollower::~FileFollower() {
+    // Keep what was committed since the last poll
+    if (dirty_ && !checkpoint_path_.empty()) {
+        save_checkpoint();
+    }
+    for (auto& file : files_) {
+        close_file(file);
+    }
+    for (auto& file : rotated_) {
+        close_file(file);
+    }
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+}
+
+void FileFollower::add(const std::string& path) {
+    auto it = std::find_if(files_.begin(), files_.end(),
+                           [&](const Followed& file) { return file.path == path; });
+    if (it != files_.end()) {
+        return;
+    }
+    Followed file;
+    file.path = path;
+    watch_directory(path);
+    open_file(file);
+    files_.push_back(std::move(file));
+}
+
+void FileFollower::remove(const std::string& path) {
+    auto it = std::find_if(files_.begin(), files_.end(),
+                           [&](const Followed& file) { return file.path == path; });
+    if (it != files_.end()) {
+        close_file(*it);
+        files_.erase(it);
+    }
+    for (auto& file : rotated_) {
+        if (file.path == path) {
+            close_file(file);
+        }
+    }
+    rotated_.erase(std::remove_if(rotated_.begin(), rotated_.end(),
+                                  [&](const Followed& file) { return file.path == path; }),
+                   rotated_.end());
+}
+
+void FileFollower::watch_directory(const std::string& path) {
+    if (inotify_fd_ < 0) {
+        return;
+    }
+    // Rotation creates or renames a new file into the directory
+    std::string directory = fs::path(path).parent_path().string();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    if (std::find(directories_.begin(), directories_.end(), directory) != directories_.end()) {
+        return;
+    }
+    if (inotify_add_watch(inotify_fd_, directory.c_str(), kDirectoryEvents) >= 0) {
+        directories_.push_back(directory);
+    }
+}
+
+void FileFollower::open_file(Followed& file) {
+    file.fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(file.fd, &st) != 0) {
+        close_file(file);
+        return;
+    }
+    file.device = static_cast<uint64_t>(st.st_dev);
+    file.inode = static_cast<uint64_t>(st.st_ino);
+    file.generation = next_generation_++;
+    file.offset = 0;
+    file.partial.clear();
+    file.pending.clear();
+    if (inotify_fd_ >= 0) {
+        file.watch = inotify_add_watch(inotify_fd_, file.path.c_str(), kFileEvents);
+    }
+
+    // Resume from the checkpoint if it describes this very file
+    auto it = std::find_if(resume_.begin(), resume_.end(),
+                           [&](const Resume& resume) { return resume.path == file.path; });
+    if (it != resume_.end()) {
+        if (it->device == file.device && it->inode == file.inode &&
+            it->offset <= static_cast<uint64_t>(st.st_size)) {
+            file.offset = it->offset;
+            file.partial = std::move(it->partial);
+            spdlog::info("Resuming {} at offset {}", file.path, file.offset);
+        }
+        resume_.erase(it);
+    }
+}
+
+void FileFollower::close_file(Followed& file) {
+    if (file.watch >= 0 && inotify_fd_ >= 0) {
+        // Fails harmlessly if the watch went away with a deleted file
+        inotify_rm_watch(inotify_fd_, file.watch);
+    }
+    file.watch = -1;
+    if (file.fd >= 0) {
+        close(file.fd);
+    }
+    file.fd = -1;
+}
+
+void FileFollower::commit(const std::string& path, const Position& end) {
+    auto it = std::find_if(files_.begin(), files_.end(),
+                           [&](const Followed& file) { return file.path == path; });
+    // Lines from a file that has since been reopened or truncated no longer
+    // affect where a restart resumes
+    if (it != files_.end() && it->generation == end.generation && it->pending.erase(end.offset) > 0) {
+        dirty_ = true;
+    }
+}
+
+size_t FileFollower::read_appended(Followed& file, const LineCallback& on_line) {
+    struct stat st;
+    if (fstat(file.fd, &st) != 0) {
+        return 0;
+    }
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (size < file.offset) {
+        // Truncated in place (copytruncate rotation)
+        spdlog::info("{} was truncated, reading from the start", file.path);
+        file.generation = next_generation_++;
+        file.offset = 0;
+        file.partial.clear();
+        file.pending.clear();
+        dirty_ = true;
+    }
+
+    size_t lines = 0;
+    // [start, end) are the file offsets the line was read from
+    auto emit = [&](std::string_view line, uint64_t start, uint64_t end) {
+        if (line.empty()) {
+            return;
+        }
+        if (!options_.auto_commit) {
+            file.pending.emplace(end, start);
+        }
+        on_line(file.path, line, Position{file.generation, end});
+        lines++;
+    };
+
+    std::vector<char> buffer(static_cast<size_t>(std::min<uint64_t>(kReadChunk, size - file.offset)));
+    while (file.offset < size) {
+        ssize_t n = pread(file.fd, buffer.data(),
+                          static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - file.offset)),
+                          static_cast<off_t>(file.offset));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        const uint64_t chunk_offset = file.offset;
+        file.offset += static_cast<uint64_t>(n);
+        dirty_ = true;
+
+        const char* begin = buffer.data();
+        const char* end = begin + n;
+        while (begin < end) {
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            if (!newline) {
+                file.partial.append(begin, end);
+                if (file.partial.size() >= kMaxLineLength) {
+                    emit(file.partial, file.offset - file.partial.size(), file.offset);
+                    file.partial.clear();
+                }
+                break;
+            }
+            const uint64_t line_end = chunk_offset + (newline - buffer.data()) + 1;
+            if (file.partial.empty()) {
+                emit(std::string_view(begin, newline - begin), line_end - (newline - begin) - 1, line_end);
+            } else {
+                const uint64_t line_start = chunk_offset - file.partial.size();
+                file.partial.append(begin, newline);
+                emit(file.partial, line_start, line_end);
+                file.partial.clear();
+            }
+            begin = newline + 1;
+        }
+    }
+    return lines;
+}
+
+size_t FileFollower::check(Followed& file, const LineCallback& on_line) {
+    if (file.fd < 0) {
+        open_file(file);
+        if (file.fd < 0) {
+            return 0;
+        }
+        dirty_ = true;
+    }
+    size_t lines = read_appended(file, on_line);
+
+    // Rotated: the path now names another file, or nothing
+    struct stat st;
+    const bool exists = stat(file.path.c_str(), &st) == 0;
+    if (exists && static_cast<uint64_t>(st.st_dev) == file.device &&
+        static_cast<uint64_t>(st.st_ino) == file.inode) {
+        return lines;
+    }
+    spdlog::info("{} was rotated", file.path);
+    if (options_.rotate_grace_ms > 0) {
+        // The writer may still hold the old file open; keep draining it
+        Followed old;
+        old.path = file.path;
+        old.fd = file.fd;
+        old.device = file.device;
+        old.inode = file.inode;
+        old.generation = file.generation;
+        old.offset = file.offset;
+        old.partial = std::move(file.partial);
+        old.watch = file.watch;
+        old.last_read = std::chrono::steady_clock::now();
+        rotated_.push_back(std::move(old));
+        file.fd = -1;
+        file.watch = -1;
+    } else {
+        // The old file was read to its end above; take its last line as complete
+        if (!file.partial.empty()) {
+            on_line(file.path, file.partial, Position{file.generation, file.offset});
+            lines++;
+        }
+        close_file(file);
+    }
+    file.partial.clear();
+    file.offset = 0;
+    file.pending.clear();
+    dirty_ = true;
+    if (exists) {
+        open_file(file);
+        if (file.fd >= 0) {
+            lines += read_appended(file, on_line);
+        }
+    }
+    return lines;
+}
+
+size_t FileFollower::drain_rotated(const LineCallback& on_line) {
+    size_t lines = 0;
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = rotated_.begin(); it != rotated_.end();) {
+        const uint64_t offset = it->offset;
+        lines += read_appended(*it, on_line);
+        // Rotated files are not checkpointed, so their lines need no commit
+        it->pending.clear();
+        if (it->offset != offset) {
+            it->last_read = now;
+            ++it;
+            continue;
+        }
+        if (now - it->last_read < std::chrono::milliseconds(options_.rotate_grace_ms)) {
+            ++it;
+            continue;
+        }
+        // Idle for the whole grace period: the writer has moved on
+        if (!it->partial.empty()) {
+            on_line(it->path, it->partial, Position{it->generation, it->offset});
+            lines++;
+        }
+        close_file(*it);
+        it = rotated_.erase(it);
+    }
+    return lines;
+}
+
+size_t FileFollower::poll(int timeout_ms, const LineCallback& on_line) {
+    size_t lines = drain_rotated(on_line);
+    for (auto& file : files_) {
+        lines += check(file, on_line);
+    }
+
+    // Wait in slices of the poll interval: inotify may never fire (NFS), and
+    // without it there is nothing to block on
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (lines == 0 && timeout_ms != 0) {
+        int wait_ms = std::max(options_.poll_interval_ms, 1);
+        if (timeout_ms > 0) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                break;
+            }
+            wait_ms = static_cast<int>(std::min<int64_t>(wait_ms, remaining));
+        }
+        if (inotify_fd_ >= 0) {
+            pollfd pfd{inotify_fd_, POLLIN, 0};
+            ::poll(&pfd, 1, wait_ms);
+            // Events only say that something changed; every file is checked
+            alignas(inotify_event) char events[4096];
+            while (read(inotify_fd_, events, sizeof(events)) > 0) {
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+        }
+        lines += drain_rotated(on_line);
+        for (auto& file : files_) {
+            lines += check(file, on_line);
+        }
+    }
+
+    if (dirty_ && !checkpoint_path_.empty()) {
+        if (save_checkpoint()) {
+            dirty_ = false;
+        } else {
+            spdlog::warn("Could not write follow checkpoint {}", checkpoint_path_);
+        }
+    }
+    return lines;
+}
+
+bool FileFollower::load_checkpoint() {
+    std::ifstream in(checkpoint_path_, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CheckpointReader reader(data);
+
+    char magic[8];
+    uint32_t version = 0;
+    uint32_t count = 0;
+    if (!reader.value(magic) || std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 ||
+        !reader.value(version) || version != kCheckpointVersion || !reader.value(count)) {
+        spdlog::warn("Ignoring follow checkpoint {}: unrecognized format", checkpoint_path_);
+        return false;
+    }
+    std::vector<Resume> resume;
+    for (uint32_t i = 0; i < count; ++i) {
+        Resume entry;
+        if (!reader.string(entry.path) || !reader.value(entry.device) || !reader.value(entry.inode) ||
+            !reader.value(entry.offset) || !reader.string(entry.partial)) {
+            spdlog::warn("Ignoring follow checkpoint {}: truncated", checkpoint_path_);
+            return false;
+        }
+        resume.push_back(std::move(entry));
+    }
+    resume_ = std::move(resume);
+    return true;
+}
+
+bool FileFollower::save_checkpoint() const {
+    std::string data(kCheckpointMagic, sizeof(kCheckpointMagic));
+    append_value(data, kCheckpointVersion);
+
+    // Files not added in this run keep their checkpointed state
+    uint32_t count = 0;
+    std::string entries;
+    auto add_entry = [&](const std::string& path, uint64_t device, uint64_t inode,
+                         uint64_t offset, const std::string& partial) {
+        append_string(entries, path);
+        append_value(entries, device);
+        append_value(entries, inode);
+        append_value(entries, offset);
+        append_string(entries, partial);
+        count++;
+    };
+    for (const auto& file : files_) {
+        if (file.fd >= 0) {
+            // Resume at the oldest uncommitted line; it is read again from the file
+            if (file.pending.empty()) {
+                add_entry(file.path, file.device, file.inode, file.offset, file.partial);
+            } else {
+                add_entry(file.path, file.device, file.inode, file.pending.begin()->second, std::string());
+            }
+        }
+    }
+    for (const auto& resume : resume_) {
+        add_entry(resume.path, resume.device, resume.inode, resume.offset, resume.partial);
+    }
+    append_value(data, count);
+    data.append(entries);
+
+    // Write to a temporary file and rename so a crash never leaves a partial checkpoint
+    const std::string tmp_path = checkpoint_path_ + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), data.size())) {
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), checkpoint_path_.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace logai
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace logai {
+
+/**
+ * @brief Follows growing log files (`tail -F`), reading only appended bytes.
+ *
+ * inotify wakes poll() when a followed file or its directory changes; files
+ * are also re-checked every Options::poll_interval_ms, which covers
+ * filesystems where inotify is unavailable or silent (such as NFS). Each
+ * poll reads every file from its last offset to its current end and hands
+ * out complete lines; a trailing partial line is held back until its
+ * newline arrives. Rotation is detected by the path resolving to a new
+ * inode, truncation by the size dropping below the offset. A rotated file
+ * stays open and is drained alongside its replacement until nothing has
+ * been appended to it for Options::rotate_grace_ms, since writers often
+ * finish a last burst before reopening the path.
+ *
+ * With a checkpoint path, the resume offset of every file is saved after
+ * each poll that changed it, keyed by device and inode. A line only counts
+ * as consumed once it is committed: by default when on_line returns, or,
+ * with Options::auto_commit off, when the consumer passes its Position to
+ * commit(). A restarted follower resumes at the oldest uncommitted line, so
+ * every line is delivered at least once. Only the current file of each path
+ * is checkpointed: lines still unread in a rotated file when the process
+ * stops are not resumed.
+ */
+class FileFollower {
+public:
+    struct Options {
+        // Commit each line as soon as on_line returns
+        bool auto_commit = true;
+        // How often a waiting poll() re-checks the files without an inotify event
+        int poll_interval_ms = 1000;
+        // How long a rotated file must stay idle before it is closed; 0
+        // closes it as soon as the rotation is seen
+        int rotate_grace_ms = 5000;
+    };
+
+    /** Identifies a delivered line for commit(). */
+    struct Position {
+        uint64_t generation = 0;  // Which open of the file the line was read from
+        uint64_t offset = 0;      // Just past the line
+    };
+
+    using LineCallback =
+        std::function<void(const std::string& path, std::string_view line, const Position& end)>;
+
+    FileFollower(std::string checkpoint_path, Options options);
+    explicit FileFollower(std::string checkpoint_path = "")
+        : FileFollower(std::move(checkpoint_path), Options()) {}
+    ~FileFollower();
+
+    FileFollower(const FileFollower&) = delete;
+    FileFollower& operator=(const FileFollower&) = delete;
+
+    /**
+     * @brief Start following `path`.
+     *
+     * Reading starts at the checkpointed offset if the checkpoint names the
+     * same file, otherwise at the beginning. The file need not exist yet.
+     */
+    void add(const std::string& path);
+    void remove(const std::string& path);
+
+    /**
+     * @brief Wait up to `timeout_ms` for new lines, then read what was appended.
+     *
+     * Returns as soon as at least one line was delivered; a negative
+     * timeout waits until then. on_line(path, line, end) is called for
+     * every new complete line.
+     *
+     * @return size_t Number of lines delivered
+     */
+    size_t poll(int timeout_ms, const LineCallback& on_line);
+
+    /**
+     * @brief Mark a line delivered by poll() as consumed.
+     *
+     * Only needed with Options::auto_commit off. Lines may be committed in
+     * any order; the checkpoint advances past every line before the oldest
+     * uncommitted one on the next poll().
+     */
+    void commit(const std::string& path, const Position& end);
+
+    bool save_checkpoint() const;
+
+    size_t size() const { return files_.size(); }
+
+private:
+    struct Followed {
+        std::string path;
+        int fd = -1;
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t generation = 0;  // Changes whenever offsets stop meaning what they did
+        uint64_t offset = 0;    // Bytes of the file consumed, including `partial`
+        std::string partial;    // Start of a line whose newline has not arrived
+        int watch = -1;
+        // Uncommitted lines: end offset -> start offset
+        std::map<uint64_t, uint64_t> pending;
+        std::chrono::steady_clock::time_point last_read;  // Rotated files: last time bytes arrived
+    };
+
+    struct Resume {
+        std::string path;
+        uint64_t device;
+        uint64_t inode;
+        uint64_t offset;
+        std::string partial;
+    };
+
+    bool load_checkpoint();
+    void open_file(Followed& file);
+    void close_file(Followed& file);
+    void watch_directory(const std::string& path);
+    size_t read_appended(Followed& file, const LineCallback& on_line);
+    size_t check(Followed& file, const LineCallback& on_line);
+    size_t drain_rotated(const LineCallback& on_line);
+
+    std::string checkpoint_path_;
+    Options options_;
+    std::vector<Followed> files_;
+    std::vector<Followed> rotated_;        // Replaced files still being drained
+    std::vector<Resume> resume_;           // Checkpointed state of files not yet added
+    std::vector<std::string> directories_; // Directories watched for rotation
+    int inotify_fd_ = -1;
+    uint64_t next_generation_ = 1;
+    bool dirty_ = false;                   // State changed since the last checkpoint
+};
+
+} // namespace logai
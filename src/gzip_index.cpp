@@ -0,0 +1,334 @@
+#include "gzip_index.h"
+#include "memory_mapped_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <zlib.h>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+
+namespace {
+
+constexpr char kSidecarMagic[8] = {'L', 'O', 'G', 'A', 'I', 'G', 'Z', 'X'};
+constexpr uint32_t kSidecarVersion = 1;
+
+// Inflate with automatic zlib/gzip header detection
+constexpr int kAutoHeaderBits = 15 + 32;
+// Gzip header only, for members after the first when resuming raw
+constexpr int kGzipHeaderBits = 15 + 16;
+constexpr size_t kGzipTrailerSize = 8;
+constexpr size_t kExtractChunk = 256 * 1024;
+
+struct SidecarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t uncompressed_size;
+    uint64_t checkpoint_count;
+};
+
+struct CheckpointHeader {
+    uint64_t uncompressed_offset;
+    uint64_t compressed_offset;
+    uint32_t bits;
+    uint32_t window_bytes;  // Size of the deflated window that follows
+};
+
+bool stat_file(const std::string& file_path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(file_path, ec);
+    if (ec) {
+        return false;
+    }
+    auto time = fs::last_write_time(file_path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+} // namespace
+
+bool GzipIndex::open(const std::string& file_path, bool persist, size_t span) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!stat_file(file_path, size, mtime)) {
+        spdlog::error("Cannot index {}: file not found", file_path);
+        return false;
+    }
+    if (load_sidecar(file_path)) {
+        return true;
+    }
+
+    MemoryMappedFile file;
+    if (!file.open(file_path)) {
+        spdlog::error("Cannot index {}: failed to map file", file_path);
+        return false;
+    }
+    if (!build(reinterpret_cast<const unsigned char*>(file.data()), file.size(), span)) {
+        spdlog::error("Cannot index {}: not a valid gzip stream", file_path);
+        return false;
+    }
+    file_mtime_ = mtime;
+    spdlog::info("Indexed {}: {} bytes uncompressed, {} checkpoints",
+                 file_path, uncompressed_size_, checkpoints_.size());
+
+    if (persist && !save_sidecar(file_path)) {
+        spdlog::warn("Could not write gzip index sidecar for {}", file_path);
+    }
+    return true;
+}
+
+bool GzipIndex::build(const unsigned char* data, size_t size, size_t span) {
+    checkpoints_.clear();
+    uncompressed_size_ = 0;
+    file_size_ = size;
+
+    z_stream strm{};
+    if (inflateInit2(&strm, kAutoHeaderBits) != Z_OK) {
+        return false;
+    }
+    strm.next_in = const_cast<unsigned char*>(data);
+    strm.avail_in = static_cast<uInt>(std::min<size_t>(size, UINT32_MAX));
+
+    // Output cycles through the window, so it always holds the last 32 KB
+    std::vector<unsigned char> window(kWindowSize, 0);
+    uint64_t total_out = 0;
+    uint64_t last = 0;
+    int ret = Z_OK;
+    while (true) {
+        if (strm.avail_out == 0) {
+            strm.next_out = window.data();
+            strm.avail_out = kWindowSize;
+        }
+        if (strm.avail_in == 0) {
+            // Inputs over 4 GB are fed to zlib in pieces
+            size_t consumed = strm.next_in - data;
+            strm.avail_in = static_cast<uInt>(std::min<size_t>(size - consumed, UINT32_MAX));
+        }
+
+        uInt before = strm.avail_out;
+        ret = inflate(&strm, Z_BLOCK);
+        total_out += before - strm.avail_out;
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR ||
+            (ret == Z_BUF_ERROR && strm.avail_in == 0)) {
+            inflateEnd(&strm);
+            return false;
+        }
+        if (ret == Z_STREAM_END) {
+            // Another member may follow this one
+            if (static_cast<size_t>(strm.next_in - data) >= size) {
+                break;
+            }
+            inflateReset(&strm);
+            continue;
+        }
+
+        // At the end of a block that is not the stream's last one, record a
+        // checkpoint if enough output has passed since the previous one
+        if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+            (checkpoints_.empty() || total_out - last >= span)) {
+            Checkpoint point;
+            point.uncompressed_offset = total_out;
+            point.compressed_offset = strm.next_in - data;
+            point.bits = strm.data_type & 7;
+            point.window.resize(kWindowSize);
+            size_t left = strm.avail_out;
+            std::memcpy(point.window.data(), window.data() + kWindowSize - left, left);
+            std::memcpy(point.window.data() + left, window.data(), kWindowSize - left);
+            checkpoints_.push_back(std::move(point));
+            last = total_out;
+        }
+    }
+    inflateEnd(&strm);
+    uncompressed_size_ = total_out;
+    return true;
+}
+
+bool GzipIndex::extract(const unsigned char* data, size_t size, size_t index,
+                        const std::function<bool(const char*, size_t)>& sink) const {
+    if (index >= checkpoints_.size()) {
+        return false;
+    }
+    const Checkpoint& point = checkpoints_[index];
+    size_t start = point.compressed_offset - (point.bits ? 1 : 0);
+    if (point.compressed_offset > size || (point.bits && point.compressed_offset == 0)) {
+        return false;
+    }
+
+    z_stream strm{};
+    if (inflateInit2(&strm, -15) != Z_OK) {
+        return false;
+    }
+    strm.next_in = const_cast<unsigned char*>(data + start);
+    strm.avail_in = static_cast<uInt>(std::min<size_t>(size - start, UINT32_MAX));
+    if (point.bits) {
+        int value = data[start] >> (8 - point.bits);
+        inflatePrime(&strm, point.bits, value);
+        strm.next_in++;
+        strm.avail_in--;
+    }
+    inflateSetDictionary(&strm, point.window.data(), kWindowSize);
+
+    std::vector<char> out(kExtractChunk);
+    bool ok = true;
+    // Only the member the checkpoint is in is inflated raw; later members
+    // are read with their gzip header, and zlib consumes their trailers
+    bool raw = true;
+    while (true) {
+        if (strm.avail_in == 0) {
+            size_t consumed = strm.next_in - data;
+            strm.avail_in = static_cast<uInt>(std::min<size_t>(size - consumed, UINT32_MAX));
+        }
+        strm.next_out = reinterpret_cast<unsigned char*>(out.data());
+        strm.avail_out = kExtractChunk;
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR ||
+            (ret == Z_BUF_ERROR && strm.avail_in == 0)) {
+            ok = false;
+            break;
+        }
+        size_t produced = kExtractChunk - strm.avail_out;
+        if (produced > 0 && !sink(out.data(), produced)) {
+            break;
+        }
+        if (ret == Z_STREAM_END) {
+            // Raw inflate leaves the member's trailer; skip it and continue
+            // with the next member's gzip header, if any
+            const size_t trailer = raw ? kGzipTrailerSize : 0;
+            size_t consumed = strm.next_in - data;
+            if (consumed + trailer >= size) {
+                break;
+            }
+            strm.next_in = const_cast<unsigned char*>(data + consumed + trailer);
+            strm.avail_in = static_cast<uInt>(std::min<size_t>(size - consumed - trailer, UINT32_MAX));
+            inflateReset2(&strm, kGzipHeaderBits);
+            raw = false;
+        }
+    }
+    inflateEnd(&strm);
+    return ok;
+}
+
+bool GzipIndex::load_sidecar(const std::string& file_path) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!stat_file(file_path, size, mtime)) {
+        return false;
+    }
+
+    std::ifstream in(sidecar_path(file_path), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    SidecarHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kSidecarMagic, sizeof(kSidecarMagic)) != 0 ||
+        header.version != kSidecarVersion) {
+        spdlog::warn("Ignoring gzip index sidecar for {}: unrecognized format", file_path);
+        return false;
+    }
+    if (header.file_size != size || header.file_mtime != mtime) {
+        // The archive changed since the sidecar was written
+        return false;
+    }
+
+    std::vector<Checkpoint> checkpoints;
+    size_t pos = sizeof(header);
+    for (uint64_t i = 0; i < header.checkpoint_count; ++i) {
+        CheckpointHeader entry;
+        if (data.size() - pos < sizeof(entry)) {
+            spdlog::warn("Ignoring gzip index sidecar for {}: truncated", file_path);
+            return false;
+        }
+        std::memcpy(&entry, data.data() + pos, sizeof(entry));
+        pos += sizeof(entry);
+        if (data.size() - pos < entry.window_bytes || entry.bits > 7 ||
+            entry.compressed_offset > size) {
+            spdlog::warn("Ignoring gzip index sidecar for {}: corrupt checkpoint", file_path);
+            return false;
+        }
+
+        Checkpoint point;
+        point.uncompressed_offset = entry.uncompressed_offset;
+        point.compressed_offset = entry.compressed_offset;
+        point.bits = static_cast<int>(entry.bits);
+        point.window.resize(kWindowSize);
+        uLongf window_size = kWindowSize;
+        if (uncompress(point.window.data(), &window_size,
+                       reinterpret_cast<const Bytef*>(data.data() + pos), entry.window_bytes) != Z_OK ||
+            window_size != kWindowSize) {
+            spdlog::warn("Ignoring gzip index sidecar for {}: corrupt window", file_path);
+            return false;
+        }
+        pos += entry.window_bytes;
+        checkpoints.push_back(std::move(point));
+    }
+
+    checkpoints_ = std::move(checkpoints);
+    uncompressed_size_ = header.uncompressed_size;
+    file_size_ = size;
+    file_mtime_ = mtime;
+    return true;
+}
+
+bool GzipIndex::save_sidecar(const std::string& file_path) const {
+    SidecarHeader header{};
+    std::memcpy(header.magic, kSidecarMagic, sizeof(kSidecarMagic));
+    header.version = kSidecarVersion;
+    header.file_size = file_size_;
+    header.file_mtime = file_mtime_;
+    header.uncompressed_size = uncompressed_size_;
+    header.checkpoint_count = checkpoints_.size();
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    std::vector<Bytef> packed(compressBound(kWindowSize));
+    for (const auto& point : checkpoints_) {
+        // Windows are recent log text and deflate well
+        uLongf packed_size = packed.size();
+        if (compress2(packed.data(), &packed_size, point.window.data(), kWindowSize,
+                      Z_BEST_SPEED) != Z_OK) {
+            return false;
+        }
+        CheckpointHeader entry{};
+        entry.uncompressed_offset = point.uncompressed_offset;
+        entry.compressed_offset = point.compressed_offset;
+        entry.bits = static_cast<uint32_t>(point.bits);
+        entry.window_bytes = static_cast<uint32_t>(packed_size);
+        data.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        data.append(reinterpret_cast<const char*>(packed.data()), packed_size);
+    }
+
+    // Write to a temporary file and rename so readers never see a partial sidecar
+    const std::string path = sidecar_path(file_path);
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), data.size())) {
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace logai
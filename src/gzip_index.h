@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace logai {
+
+/**
+ * @brief Random-access checkpoints into a gzip file.
+ *
+ * One sequential pass records, about every `span` bytes of output, where a
+ * deflate block starts (byte offset plus the bit within that byte) together
+ * with the 32 KB of output preceding it, the dictionary needed to resume
+ * inflating there (the approach of zlib's zran example). Regions between
+ * checkpoints can then be decompressed independently, and in parallel.
+ * Concatenated gzip members are supported.
+ *
+ * The checkpoints can be saved next to the file as `<file>.gzidx`, keyed by
+ * the file's size and mtime like LineIndex sidecars.
+ */
+class GzipIndex {
+public:
+    static constexpr size_t kWindowSize = 32768;
+    static constexpr size_t kDefaultSpan = 4 << 20;
+
+    struct Checkpoint {
+        uint64_t uncompressed_offset = 0;
+        uint64_t compressed_offset = 0;  // Byte holding the block's first bit
+        int bits = 0;                    // Bits of the previous byte still to read (0-7)
+        std::vector<unsigned char> window;
+    };
+
+    /**
+     * @brief Load the sidecar for `file_path` if it is current, otherwise
+     * build the index and (if `persist`) save it.
+     */
+    bool open(const std::string& file_path, bool persist = true, size_t span = kDefaultSpan);
+
+    /** Index a gzip stream held in memory. */
+    bool build(const unsigned char* data, size_t size, size_t span = kDefaultSpan);
+
+    bool load_sidecar(const std::string& file_path);
+    bool save_sidecar(const std::string& file_path) const;
+
+    static std::string sidecar_path(const std::string& file_path) {
+        return file_path + ".gzidx";
+    }
+
+    /**
+     * @brief Decompress from checkpoint `index` onwards.
+     *
+     * Output is passed to `sink` in pieces until it returns false or the
+     * stream ends.
+     *
+     * @return bool False on a corrupt stream
+     */
+    bool extract(const unsigned char* data, size_t size, size_t index,
+                 const std::function<bool(const char*, size_t)>& sink) const;
+
+    const std::vector<Checkpoint>& checkpoints() const { return checkpoints_; }
+    uint64_t uncompressed_size() const { return uncompressed_size_; }
+
+private:
+    std::vector<Checkpoint> checkpoints_;
+    uint64_t uncompressed_size_ = 0;
+    uint64_t file_size_ = 0;
+    int64_t file_mtime_ = 0;
+};
+
+} // namespace logai
@@ -0,0 +1,103 @@
+#include "ingest_checkpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace logai {
+
+namespace {
+
+constexpr char kSidecarMagic[8] = {'L', 'O', 'G', 'A', 'I', 'C', 'K', 'P'};
+constexpr uint32_t kSidecarVersion = 1;
+constexpr uint64_t kHashWindow = 64 * 1024;
+
+struct SidecarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t inode;
+    uint64_t offset;
+    uint64_t prefix_hash;
+    uint64_t fingerprint;
+};
+
+// FNV-1a: stable across builds and platforms, unlike std::hash
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+
+} // namespace
+
+uint64_t IngestCheckpoint::hash(const std::string& text, uint64_t seed) {
+    return fnv1a(text.data(), text.size(), kFnvOffset ^ seed);
+}
+
+uint64_t IngestCheckpoint::hash_prefix(const char* data, uint64_t size) {
+    const uint64_t head = std::min(size, kHashWindow);
+    const uint64_t tail = std::min(size - head, kHashWindow);
+    uint64_t hash = fnv1a(data, head, kFnvOffset ^ size);
+    return fnv1a(data + size - tail, tail, hash);
+}
+
+bool IngestCheckpoint::matches(const char* data, uint64_t size, uint64_t file_inode, uint64_t settings) const {
+    return inode == file_inode && fingerprint == settings && offset <= size &&
+           prefix_hash == hash_prefix(data, offset);
+}
+
+bool IngestCheckpoint::load_sidecar(const std::string& file_path) {
+    std::ifstream in(sidecar_path(file_path), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    SidecarHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        spdlog::warn("Ignoring ingest checkpoint for {}: truncated", file_path);
+        return false;
+    }
+    if (std::memcmp(header.magic, kSidecarMagic, sizeof(kSidecarMagic)) != 0 ||
+        header.version != kSidecarVersion) {
+        spdlog::warn("Ignoring ingest checkpoint for {}: unrecognized format", file_path);
+        return false;
+    }
+    inode = header.inode;
+    offset = header.offset;
+    prefix_hash = header.prefix_hash;
+    fingerprint = header.fingerprint;
+    return true;
+}
+
+bool IngestCheckpoint::save_sidecar(const std::string& file_path) const {
+    SidecarHeader header{};
+    std::memcpy(header.magic, kSidecarMagic, sizeof(kSidecarMagic));
+    header.version = kSidecarVersion;
+    header.inode = inode;
+    header.offset = offset;
+    header.prefix_hash = prefix_hash;
+    header.fingerprint = fingerprint;
+
+    // Write to a temporary file and rename so readers never see a partial sidecar
+    const std::string path = sidecar_path(file_path);
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(reinterpret_cast<const char*>(&header), sizeof(header))) {
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace logai
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace logai {
+
+/**
+ * @brief How far an earlier load of a growing log file got.
+ *
+ * Persisted next to the file as a sidecar (`<file>.lckpt`) so a later run
+ * parses only the bytes appended since. It holds the file's inode, the
+ * offset parsing stopped at (the end of the last complete line), a hash of
+ * the bytes before that offset and a fingerprint of the parse settings. A
+ * file that was rotated, truncated or rewritten, or settings that changed,
+ * fail the check and the file is parsed from the start again.
+ *
+ * The content hash covers the first and last 64 KB of the parsed prefix
+ * rather than all of it, so validating a checkpoint does not read back
+ * the whole file.
+ */
+struct IngestCheckpoint {
+    uint64_t inode = 0;
+    uint64_t offset = 0;
+    uint64_t prefix_hash = 0;
+    uint64_t fingerprint = 0;
+
+    bool load_sidecar(const std::string& file_path);
+    bool save_sidecar(const std::string& file_path) const;
+
+    /** Whether this checkpoint describes a prefix of the (mapped) file. */
+    bool matches(const char* data, uint64_t size, uint64_t file_inode, uint64_t settings) const;
+
+    static uint64_t hash_prefix(const char* data, uint64_t size);
+
+    /** Stable hash of `text`, for fingerprinting settings. */
+    static uint64_t hash(const std::string& text, uint64_t seed = 0);
+
+    static std::string sidecar_path(const std::string& file_path) {
+        return file_path + ".lckpt";
+    }
+
+    /** DRAIN state learned up to the checkpoint, so cluster IDs carry over. */
+    static std::string drain_snapshot_path(const std::string& file_path) {
+        return file_path + ".ldrain";
+    }
+};
+
+} // namespace logai
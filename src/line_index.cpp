@@ -0,0 +1,212 @@
+#include "line_index.h"
+#include "memory_mapped_file.h"
+#include "simd_scanner.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+
+namespace {
+
+constexpr char kSidecarMagic[8] = {'L', 'O', 'G', 'A', 'I', 'L', 'I', 'X'};
+constexpr uint32_t kSidecarVersion = 1;
+
+struct SidecarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t line_count;
+};
+
+bool stat_file(const std::string& file_path, uint64_t& size, int64_t& mtime) {
+    std::error_code ec;
+    size = fs::file_size(file_path, ec);
+    if (ec) {
+        return false;
+    }
+    auto time = fs::last_write_time(file_path, ec);
+    if (ec) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool get_varint(const char*& pos, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*pos++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool LineIndex::open(const std::string& file_path, bool persist) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!stat_file(file_path, size, mtime)) {
+        spdlog::error("Cannot index {}: file not found", file_path);
+        return false;
+    }
+    if (load_sidecar(file_path)) {
+        return true;
+    }
+
+    MemoryMappedFile file;
+    if (size > 0 && !file.open(file_path)) {
+        spdlog::error("Cannot index {}: failed to map file", file_path);
+        return false;
+    }
+    build(std::string_view(file.data(), file.size()));
+    file_mtime_ = mtime;
+
+    if (persist && !save_sidecar(file_path)) {
+        spdlog::warn("Could not write line index sidecar for {}", file_path);
+    }
+    return true;
+}
+
+bool LineIndex::is_current(const std::string& file_path) const {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    return stat_file(file_path, size, mtime) && size == file_size_ && mtime == file_mtime_;
+}
+
+void LineIndex::build(std::string_view contents) {
+    // Newline positions become the starts of the lines after them
+    auto newlines = SimdLogScanner::findAllChar(contents.data(), contents.size(), '\n');
+    offsets_.clear();
+    offsets_.reserve(newlines.size() + 1);
+    if (!contents.empty()) {
+        offsets_.push_back(0);
+    }
+    for (size_t pos : newlines) {
+        if (pos + 1 < contents.size()) {
+            offsets_.push_back(pos + 1);
+        }
+    }
+    file_size_ = contents.size();
+}
+
+bool LineIndex::load_sidecar(const std::string& file_path) {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!stat_file(file_path, size, mtime)) {
+        return false;
+    }
+
+    std::ifstream in(sidecar_path(file_path), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    SidecarHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kSidecarMagic, sizeof(kSidecarMagic)) != 0 ||
+        header.version != kSidecarVersion) {
+        spdlog::warn("Ignoring line index sidecar for {}: unrecognized format", file_path);
+        return false;
+    }
+    if (header.file_size != size || header.file_mtime != mtime) {
+        // The log changed since the sidecar was written
+        return false;
+    }
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(std::min<uint64_t>(header.line_count, data.size()));
+    const char* pos = data.data() + sizeof(header);
+    const char* end = data.data() + data.size();
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < header.line_count; ++i) {
+        uint64_t delta = 0;
+        if (!get_varint(pos, end, delta)) {
+            spdlog::warn("Ignoring line index sidecar for {}: truncated", file_path);
+            return false;
+        }
+        offset += delta;
+        if (offset >= size || (i > 0 && delta == 0)) {
+            spdlog::warn("Ignoring line index sidecar for {}: corrupt offsets", file_path);
+            return false;
+        }
+        offsets.push_back(offset);
+    }
+
+    offsets_ = std::move(offsets);
+    file_size_ = size;
+    file_mtime_ = mtime;
+    return true;
+}
+
+bool LineIndex::save_sidecar(const std::string& file_path) const {
+    SidecarHeader header{};
+    std::memcpy(header.magic, kSidecarMagic, sizeof(kSidecarMagic));
+    header.version = kSidecarVersion;
+    header.file_size = file_size_;
+    header.file_mtime = file_mtime_;
+    header.line_count = offsets_.size();
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t previous = 0;
+    for (uint64_t offset : offsets_) {
+        put_varint(data, offset - previous);
+        previous = offset;
+    }
+
+    // Write to a temporary file and rename so readers never see a partial sidecar
+    const std::string path = sidecar_path(file_path);
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write(data.data(), data.size())) {
+            return false;
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string_view LineIndex::line(std::string_view contents, size_t index) const {
+    if (index >= offsets_.size() || offsets_[index] >= contents.size()) {
+        return {};
+    }
+    size_t begin = offsets_[index];
+    size_t end = index + 1 < offsets_.size() ? offsets_[index + 1] - 1 : contents.size();
+    end = std::min(end, contents.size());
+    if (end > begin && contents[end - 1] == '\n') {
+        --end;
+    }
+    return contents.substr(begin, end - begin);
+}
+
+} // namespace logai
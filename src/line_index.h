@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace logai {
+
+/**
+ * @brief Byte offsets of every line start in a log file.
+ *
+ * Built with SimdLogScanner::findAllChar over a memory mapped file, so
+ * locating line N afterwards is a single array lookup. The index can be
+ * persisted next to the file as a sidecar (`<file>.lidx`) holding the
+ * offsets delta-encoded as varints, keyed by the file's size and mtime so
+ * a stale sidecar is rebuilt instead of used.
+ */
+class LineIndex {
+public:
+    /**
+     * @brief Index `file_path`, reusing its sidecar when it is up to date.
+     *
+     * @param file_path The log file to index
+     * @param persist Write a fresh sidecar when the index had to be built
+     * @return bool True if the index is ready
+     */
+    bool open(const std::string& file_path, bool persist = true);
+
+    /** Scan the (already mapped) file contents for line starts. */
+    void build(std::string_view contents);
+
+    /** Whether `file_path` still has the size and mtime this index was built for. */
+    bool is_current(const std::string& file_path) const;
+
+    bool load_sidecar(const std::string& file_path);
+    bool save_sidecar(const std::string& file_path) const;
+
+    static std::string sidecar_path(const std::string& file_path) {
+        return file_path + ".lidx";
+    }
+
+    size_t line_count() const { return offsets_.size(); }
+
+    /** Line `index` of `contents`, without its trailing newline. */
+    std::string_view line(std::string_view contents, size_t index) const;
+
+private:
+    std::vector<uint64_t> offsets_;
+    uint64_t file_size_ = 0;
+    int64_t file_mtime_ = 0;
+};
+
+} // namespace logai
@@ -0,0 +1,331 @@
+#include "log_prefix_matcher.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+namespace logai {
+
+namespace {
+
+// Header prefixes practically always fit here; anything beyond is checked
+// byte by byte
+constexpr size_t kClassifiedBytes = 64;
+
+inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Same set as ECMAScript \s for single-byte input
+inline bool is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool is_word(char c) {
+    const char lower = static_cast<char>(c | 0x20);
+    return is_digit(c) || (lower >= 'a' && lower <= 'z') || c == '_';
+}
+
+/**
+ * Digit and whitespace bitmasks over the first 64 bytes of a line (bit i
+ * describes byte i), so the recognizers can measure runs with a bit scan.
+ */
+class PrefixClasses {
+public:
+    explicit PrefixClasses(std::string_view line)
+        : data_(line.data()), size_(line.size()), covered_(std::min(line.size(), kClassifiedBytes))
+    {
+        classify();
+    }
+
+    size_t size() const { return size_; }
+
+    char at(size_t i) const { return i < size_ ? data_[i] : '\0'; }
+
+    size_t digit_run(size_t i) const { return run(digits_, i, is_digit); }
+
+    size_t space_run(size_t i) const { return run(spaces_, i, is_space); }
+
+    size_t word_run(size_t i) const {
+        size_t pos = i;
+        while (pos < size_ && is_word(data_[pos])) {
+            ++pos;
+        }
+        return pos - i;
+    }
+
+private:
+    void classify() {
+#if defined(__AVX2__)
+        if (size_ >= kClassifiedBytes) {
+            for (size_t half = 0; half < 2; ++half) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data_ + half * 32));
+                const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('0' - 1)),
+                                                       _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chunk));
+                const __m256i space = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                    _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8('\t' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), chunk)));
+                digits_ |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(digit))) << (half * 32);
+                spaces_ |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << (half * 32);
+            }
+            return;
+        }
+#elif defined(__SSE4_2__)
+        if (size_ >= kClassifiedBytes) {
+            for (size_t quarter = 0; quarter < 4; ++quarter) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data_ + quarter * 16));
+                const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                                                    _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+                const __m128i space = _mm_or_si128(
+                    _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                    _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('\t' - 1)),
+                                  _mm_cmplt_epi8(chunk, _mm_set1_epi8('\r' + 1))));
+                digits_ |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(digit))) << (quarter * 16);
+                spaces_ |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(space))) << (quarter * 16);
+            }
+            return;
+        }
+#endif
+        for (size_t i = 0; i < covered_; ++i) {
+            digits_ |= static_cast<uint64_t>(is_digit(data_[i])) << i;
+            spaces_ |= static_cast<uint64_t>(is_space(data_[i])) << i;
+        }
+    }
+
+    size_t run(uint64_t mask, size_t i, bool (*scalar)(char)) const {
+        size_t pos = i;
+        if (pos < covered_) {
+            // Bits at and above covered_ are clear, so the scan stops there at the latest
+            const uint64_t inverted = ~(mask >> pos);
+            pos += inverted ? static_cast<size_t>(__builtin_ctzll(inverted)) : kClassifiedBytes;
+            pos = std::min(pos, covered_);
+            if (pos < covered_) {
+                return pos - i;
+            }
+        }
+        while (pos < size_ && scalar(data_[pos])) {
+            ++pos;
+        }
+        return pos - i;
+    }
+
+    const char* data_;
+    size_t size_;
+    size_t covered_;
+    uint64_t digits_ = 0;
+    uint64_t spaces_ = 0;
+};
+
+// Consume a run of min..max digits. A longer run can never match because
+// every such field in the patterns is followed by a non-digit.
+bool digits(const PrefixClasses& c, size_t& pos, size_t min, size_t max) {
+    const size_t n = c.digit_run(pos);
+    if (n < min || n > max) {
+        return false;
+    }
+    pos += n;
+    return true;
+}
+
+bool literal(const PrefixClasses& c, size_t& pos, char expected) {
+    if (c.at(pos) != expected) {
+        return false;
+    }
+    ++pos;
+    return true;
+}
+
+// \s+
+bool spaces(const PrefixClasses& c, size_t& pos) {
+    const size_t n = c.space_run(pos);
+    pos += n;
+    return n > 0;
+}
+
+// (?:\.\d+)?
+void fraction(const PrefixClasses& c, size_t& pos) {
+    if (c.at(pos) == '.') {
+        const size_t n = c.digit_run(pos + 1);
+        if (n > 0) {
+            pos += 1 + n;
+        }
+    }
+}
+
+// \d{1,2}:\d{1,2}:\d{1,2}(?:\.\d+)?\s+
+bool clock(const PrefixClasses& c, size_t& pos) {
+    if (!digits(c, pos, 1, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 1, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 1, 2)) {
+        return false;
+    }
+    fraction(c, pos);
+    return spaces(c, pos);
+}
+
+size_t bracket(const PrefixClasses& c) {
+    if (c.at(0) != '[') {
+        return 0;
+    }
+    // `.` does not cross line terminators
+    for (size_t pos = 1; pos < c.size(); ++pos) {
+        const char ch = c.at(pos);
+        if (ch == ']') {
+            ++pos;
+            return pos + c.space_run(pos);
+        }
+        if (ch == '\n' || ch == '\r') {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+size_t date_time(const PrefixClasses& c) {
+    size_t pos = 0;
+    if (!digits(c, pos, 4, 4)) {
+        return 0;
+    }
+    for (int field = 0; field < 2; ++field) {
+        const char sep = c.at(pos);
+        if ((sep != '-' && sep != '/') || !digits(c, ++pos, 1, 2)) {
+            return 0;
+        }
+    }
+    if (!spaces(c, pos) || !clock(c, pos)) {
+        return 0;
+    }
+    return pos;
+}
+
+size_t time_of_day(const PrefixClasses& c) {
+    size_t pos = 0;
+    return clock(c, pos) ? pos : 0;
+}
+
+size_t level(const PrefixClasses& c) {
+    // WARNING before WARN so the longer keyword wins, as WARN(?:ING)? does
+    static constexpr std::string_view kLevels[] = {
+        "ERROR", "WARNING", "WARN", "INFO", "DEBUG", "TRACE", "FATAL"
+    };
+    size_t pos = c.space_run(0);
+    for (std::string_view keyword : kLevels) {
+        if (pos + keyword.size() > c.size()) {
+            continue;
+        }
+        bool matched = true;
+        for (size_t i = 0; i < keyword.size() && matched; ++i) {
+            matched = (c.at(pos + i) & ~0x20) == keyword[i];
+        }
+        // Require a word boundary so "Information ..." keeps its first word
+        if (!matched || is_word(c.at(pos + keyword.size()))) {
+            continue;
+        }
+        pos += keyword.size();
+        pos += c.space_run(pos);
+        if (c.at(pos) == ':') {
+            ++pos;
+            pos += c.space_run(pos);
+        }
+        return pos;
+    }
+    return 0;
+}
+
+size_t ctime(const PrefixClasses& c) {
+    size_t pos = 0;
+    for (int word = 0; word < 2; ++word) {
+        const size_t n = c.word_run(pos);
+        pos += n;
+        if (n == 0 || !spaces(c, pos)) {
+            return 0;
+        }
+    }
+    const size_t day = c.digit_run(pos);
+    pos += day;
+    if (day == 0 || !spaces(c, pos)) {
+        return 0;
+    }
+    if (!digits(c, pos, 2, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 2, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 2, 2) || !spaces(c, pos) ||
+        !digits(c, pos, 4, 4) || !spaces(c, pos)) {
+        return 0;
+    }
+    return pos;
+}
+
+size_t iso8601(const PrefixClasses& c) {
+    size_t pos = 0;
+    if (!digits(c, pos, 4, 4) || !literal(c, pos, '-') ||
+        !digits(c, pos, 2, 2) || !literal(c, pos, '-') ||
+        !digits(c, pos, 2, 2) || !literal(c, pos, 'T') ||
+        !digits(c, pos, 2, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 2, 2) || !literal(c, pos, ':') ||
+        !digits(c, pos, 2, 2)) {
+        return 0;
+    }
+    fraction(c, pos);
+
+    // (?:Z|[+-]\d{2}:?\d{2})?
+    const char zone = c.at(pos);
+    if (zone == 'Z') {
+        ++pos;
+    } else if (zone == '+' || zone == '-') {
+        const size_t n = c.digit_run(pos + 1);
+        if (n == 4) {
+            pos += 5;
+        } else if (n == 2 && c.at(pos + 3) == ':' && c.digit_run(pos + 4) == 2) {
+            pos += 6;
+        }
+    }
+    return spaces(c, pos) ? pos : 0;
+}
+
+} // namespace
+
+size_t LogPrefixMatcher::strip_length(std::string_view line) {
+    if (line.empty()) {
+        return 0;
+    }
+    const PrefixClasses classes(line);
+    for (auto recognizer : {bracket, date_time, time_of_day, level, ctime, iso8601}) {
+        const size_t n = recognizer(classes);
+        if (n > 0 && n < line.size()) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+size_t LogPrefixMatcher::match_bracket(std::string_view line) {
+    return bracket(PrefixClasses(line));
+}
+
+size_t LogPrefixMatcher::match_date_time(std::string_view line) {
+    return date_time(PrefixClasses(line));
+}
+
+size_t LogPrefixMatcher::match_time(std::string_view line) {
+    return time_of_day(PrefixClasses(line));
+}
+
+size_t LogPrefixMatcher::match_level(std::string_view line) {
+    return level(PrefixClasses(line));
+}
+
+size_t LogPrefixMatcher::match_ctime(std::string_view line) {
+    return ctime(PrefixClasses(line));
+}
+
+size_t LogPrefixMatcher::match_iso8601(std::string_view line) {
+    return iso8601(PrefixClasses(line));
+}
+
+} // namespace logai
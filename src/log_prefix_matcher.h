@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace logai {
+
+/**
+ * @brief Hand-written recognizer for common log-line header prefixes.
+ *
+ * Replaces the default header-stripping regexes used by the DRAIN parser.
+ * The first 64 bytes of a line are classified once (digits and whitespace)
+ * with SIMD, and each recognizer walks those bitmasks instead of running a
+ * regex engine. Every recognizer returns the length of the prefix it
+ * matched (including trailing whitespace), or 0 if the line does not start
+ * with that form.
+ */
+class LogPrefixMatcher {
+public:
+    /**
+     * @brief Length of the header prefix to strip from a line.
+     *
+     * Tries the recognizers in the order the DRAIN defaults always used and
+     * returns the first match that leaves a non-empty remainder, or 0.
+     */
+    static size_t strip_length(std::string_view line);
+
+    /** `[...]` followed by optional whitespace */
+    static size_t match_bracket(std::string_view line);
+
+    /** `2024-03-24 10:15:30[.123] ` (also `/` separators, 1-2 digit fields) */
+    static size_t match_date_time(std::string_view line);
+
+    /** `10:15:30[.123] ` */
+    static size_t match_time(std::string_view line);
+
+    /** `  ERROR: `, `Warning `, ... (case-insensitive severity keyword) */
+    static size_t match_level(std::string_view line);
+
+    /** `Mon Mar 24 10:15:30 2024 ` */
+    static size_t match_ctime(std::string_view line);
+
+    /** `2024-03-24T10:15:30[.123][Z|+hh:mm] ` */
+    static size_t match_iso8601(std::string_view line);
+};
+
+} // namespace logai
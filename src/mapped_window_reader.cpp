@@ -0,0 +1,132 @@
+#include "mapped_window_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <folly/synchronization/AtomicNotification.h>
+#include <spdlog/spdlog.h>
+
+namespace logai {
+
+namespace {
+
+// Window sizes are kept a multiple of the huge page size, which also keeps
+// every window offset page aligned as mmap requires
+constexpr size_t kWindowAlignment = 2 << 20;
+
+} // namespace
+
+/**
+ * Shared with the windows handed out, so the file stays open for page
+ * cache hints until the last window is released.
+ */
+struct MappedWindowReader::State {
+    ~State() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    void release(void* address, size_t length, uint64_t offset) {
+        munmap(address, length);
+        if (drop_behind) {
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), POSIX_FADV_DONTNEED);
+        }
+        live.fetch_sub(1);
+        releases.fetch_add(1);
+        if (waiting.load() != 0) {
+            folly::atomic_notify_all(&releases);
+        }
+    }
+
+    int fd = -1;
+    bool drop_behind = true;
+    std::atomic<size_t> live{0};
+    std::atomic<uint32_t> releases{0};
+    std::atomic<uint32_t> waiting{0};
+};
+
+MappedWindowReader::MappedWindowReader(Options options) : options_(options) {
+    options_.window_size = std::max<size_t>(options_.window_size, 1);
+    options_.window_size = (options_.window_size + kWindowAlignment - 1) / kWindowAlignment * kWindowAlignment;
+    // One window being handed out plus the one mapped ahead of it
+    options_.max_windows = std::max<size_t>(options_.max_windows, 2);
+}
+
+bool MappedWindowReader::read(const std::string& path,
+                              const std::function<void(const Block&, size_t)>& on_block,
+                              const std::function<bool()>& idle) {
+    auto state = std::make_shared<State>();
+    state->drop_behind = options_.drop_behind;
+    state->fd = ::open(path.c_str(), O_RDONLY);
+    if (state->fd < 0) {
+        spdlog::error("Failed to open file: {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    struct stat sb;
+    if (fstat(state->fd, &sb) != 0) {
+        spdlog::error("Failed to stat file: {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(sb.st_size);
+    posix_fadvise(state->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    auto map_window = [&](uint64_t offset, Block& block) {
+        // Never hold more than max_windows, counting the one about to be mapped
+        while (state->live.load() >= options_.max_windows) {
+            if (idle()) {
+                continue;
+            }
+            uint32_t epoch = state->releases.load();
+            state->waiting.fetch_add(1);
+            if (state->live.load() >= options_.max_windows) {
+                folly::atomic_wait(&state->releases, epoch);
+            }
+            state->waiting.fetch_sub(1);
+        }
+
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(options_.window_size, file_size - offset));
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, state->fd, static_cast<off_t>(offset));
+        if (address == MAP_FAILED) {
+            spdlog::error("Failed to map {} bytes of {} at offset {}: {}",
+                          length, path, offset, std::strerror(errno));
+            return false;
+        }
+        madvise(address, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if (options_.huge_pages) {
+            madvise(address, length, MADV_HUGEPAGE);
+        }
+#endif
+        // Start readahead now so the window is warm when the cursor gets there
+        madvise(address, length, MADV_WILLNEED);
+        state->live.fetch_add(1);
+        block = Block(static_cast<const char*>(address), [state, address, length, offset](const char*) {
+            state->release(address, length, offset);
+        });
+        return true;
+    };
+
+    Block next;
+    if (file_size > 0 && !map_window(0, next)) {
+        return false;
+    }
+    for (uint64_t offset = 0; offset < file_size; offset += options_.window_size) {
+        Block current = std::move(next);
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(options_.window_size, file_size - offset));
+        const uint64_t next_offset = offset + options_.window_size;
+        if (next_offset < file_size && !map_window(next_offset, next)) {
+            return false;
+        }
+        on_block(current, length);
+    }
+    return true;
+}
+
+} // namespace logai
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace logai {
+
+/**
+ * @brief Sequential reader that maps a file one fixed-size window at a time.
+ *
+ * Mapping a whole 200 GB file lets its pages crowd everything else out of
+ * the page cache. Here each window is mapped with MADV_SEQUENTIAL, the next
+ * one is mapped and MADV_WILLNEED'd before the current one is handed out,
+ * and a window is unmapped (and, with `drop_behind`, dropped from the page
+ * cache) as soon as the last reference to it goes away. At most
+ * `max_windows` are mapped at once, so resident file pages stay bounded.
+ *
+ * Windows are handed out in file order as reference-counted blocks, like
+ * UringFileReader, so the same callers can parse straight out of them.
+ */
+class MappedWindowReader {
+public:
+    struct Options {
+        size_t window_size = 64 << 20;  // Rounded up to a multiple of 2 MB
+        size_t max_windows = 4;
+        bool huge_pages = false;        // MADV_HUGEPAGE, where the filesystem supports it
+        bool drop_behind = true;        // POSIX_FADV_DONTNEED released windows
+    };
+
+    using Block = std::shared_ptr<const char>;
+
+    explicit MappedWindowReader(Options options);
+    MappedWindowReader() : MappedWindowReader(Options()) {}
+
+    /**
+     * @brief Map `path` window by window, front to back.
+     *
+     * `on_block(block, size)` is called on this thread for every window in
+     * file order. While `max_windows` are still referenced, `idle()` is
+     * called before sleeping; it returns true if it did some useful work
+     * (such as handing blocks on so they get released).
+     *
+     * @return bool False if the file could not be opened or mapped
+     */
+    bool read(const std::string& path,
+              const std::function<void(const Block&, size_t)>& on_block,
+              const std::function<bool()>& idle);
+
+private:
+    struct State;
+
+    Options options_;
+};
+
+} // namespace logai
@@ -0,0 +1,80 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace logai {
+
+namespace {
+
+constexpr char kCgroupRoot[] = "/sys/fs/cgroup";
+
+// This process's cgroup v2 directory relative to the hierarchy root ("" if
+// not in a unified hierarchy)
+std::string cgroup_path() {
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.rfind("0::", 0) == 0) {
+            std::string path = line.substr(3);
+            return path == "/" ? "" : path;
+        }
+    }
+    return "";
+}
+
+// A numeric cgroup control file; 0 for "max", missing or unreadable files
+size_t read_cgroup_value(const std::string& file) {
+    std::ifstream in(file);
+    std::string value;
+    if (!(in >> value) || value == "max") {
+        return 0;
+    }
+    try {
+        return static_cast<size_t>(std::stoull(value));
+    } catch (const std::exception&) {
+        return 0;
+    }
+}
+
+} // namespace
+
+size_t MemoryBudget::cgroup_limit() {
+    // The effective limit is the tightest one on the way up to the root
+    std::string path = cgroup_path();
+    size_t limit = 0;
+    while (true) {
+        size_t value = read_cgroup_value(kCgroupRoot + path + "/memory.max");
+        if (value > 0) {
+            limit = limit > 0 ? std::min(limit, value) : value;
+        }
+        if (path.empty()) {
+            break;
+        }
+        path.resize(path.find_last_of('/'));
+    }
+    return limit;
+}
+
+size_t MemoryBudget::cgroup_usage() {
+    return read_cgroup_value(kCgroupRoot + cgroup_path() + "/memory.current");
+}
+
+size_t MemoryBudget::resident_bytes() {
+#ifndef _WIN32
+    std::ifstream in("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (in >> total_pages >> resident_pages) {
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+} // namespace logai
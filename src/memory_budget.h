@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <folly/synchronization/AtomicNotification.h>
+
+namespace logai {
+
+/**
+ * @brief Byte budget for data held between pipeline stages.
+ *
+ * Producers acquire() bytes before creating more work and block while the
+ * budget is spent; whoever frees the data release()s them. Stages that must
+ * not block (parse tasks swapping raw lines for records) use add(), which
+ * may overshoot and so holds back the producer for longer. A lone request
+ * larger than the whole budget is let through when nothing else is held, so
+ * the pipeline can always make progress.
+ */
+class MemoryBudget {
+public:
+    /** `limit` in bytes; 0 means unlimited. */
+    explicit MemoryBudget(size_t limit) : limit_(limit) {}
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    /**
+     * @brief Charge `bytes`, waiting while they do not fit.
+     *
+     * `idle()` is called before each sleep; it returns true if it did some
+     * useful work (then the budget is checked again without sleeping).
+     */
+    template<typename Idle>
+    void acquire(size_t bytes, Idle&& idle) {
+        while (!try_acquire(bytes)) {
+            if (idle()) {
+                continue;
+            }
+            uint32_t epoch = releases_.load();
+            waiting_.fetch_add(1);
+            if (!fits(bytes)) {
+                folly::atomic_wait(&releases_, epoch);
+            }
+            waiting_.fetch_sub(1);
+        }
+    }
+
+    bool try_acquire(size_t bytes) {
+        size_t used = used_.load();
+        while (limit_ == 0 || used == 0 || used + bytes <= limit_) {
+            if (used_.compare_exchange_weak(used, used + bytes)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add(size_t bytes) {
+        used_.fetch_add(bytes);
+    }
+
+    void release(size_t bytes) {
+        used_.fetch_sub(bytes);
+        releases_.fetch_add(1);
+        if (waiting_.load() != 0) {
+            folly::atomic_notify_all(&releases_);
+        }
+    }
+
+    size_t used() const { return used_.load(); }
+    size_t limit() const { return limit_; }
+
+    /** The cgroup v2 `memory.max` of this process, or 0 if there is none. */
+    static size_t cgroup_limit();
+
+    /** The cgroup v2 `memory.current` of this process, or 0 if unavailable. */
+    static size_t cgroup_usage();
+
+    /** Resident set size of this process in bytes, or 0 if unavailable. */
+    static size_t resident_bytes();
+
+private:
+    bool fits(size_t bytes) const {
+        size_t used = used_.load();
+        return limit_ == 0 || used == 0 || used + bytes <= limit_;
+    }
+
+    const size_t limit_;
+    alignas(64) std::atomic<size_t> used_{0};
+    std::atomic<uint32_t> releases_{0};
+    std::atomic<uint32_t> waiting_{0};
+};
+
+} // namespace logai
@@ -4,51 +4,52 @@
 
 namespace logai {
 
-MultiFileReader::MultiFileReader(const std::vector<FileEntry>& files) : files_(files) {
+MultiFileReader::MultiFileReader(const std::vector<FileEntry>& files, const std::string& checkpoint_path)
+    : files_(files) {
+    // Followed lines are committed once nextEntry() hands them out, so a
+    // restart does not lose lines that were queued but never consumed
+    FileFollower::Options follow_options;
+    follow_options.auto_commit = false;
+    follower_ = std::make_unique<FileFollower>(checkpoint_path, follow_options);
+
     for (const auto& file : files) {
-        FileDataLoaderConfig config;
-        config.file_path = file.filename;
-        config.format = file.format;
-        // Maps follow and compressed fields to appropriate settings
-        // These don't exist directly in FileDataLoaderConfig, map to appropriate fields
-        if (file.follow) {
-            // Handle follow mode settings
-        }
-        if (file.compressed) {
-            config.decompress = file.compressed;
-        }
-        
-        auto loader = std::make_unique<FileDataLoader>(file.filename, config);
-        loaders_.push_back(std::move(loader));
+        openFile(file);
     }
     
     fillQueue();
 }
 
-void MultiFileReader::addFile(const FileEntry& file) {
-    // Check if file already exists
-    auto it = std::find_if(files_.begin(), files_.end(),
-        [&](const FileEntry& entry) { return entry.filename == file.filename; });
-    
-    if (it != files_.end()) {
-        throw std::runtime_error("File already exists: " + file.filename);
+void MultiFileReader::openFile(const FileEntry& file) {
+    if (file.follow) {
+        // Followed files are read by the follower as they grow, not by a loader
+        follower_->add(file.filename);
+        follow_parsers_[file.filename] = LogParserFactory::create(file.format);
+        loaders_.push_back(nullptr);
+        return;
     }
     
-    files_.push_back(file);
-    
     FileDataLoaderConfig config;
     config.file_path = file.filename;
     config.format = file.format;
-    // Maps follow and compressed fields to appropriate settings
-    if (file.follow) {
-        // Handle follow mode settings
-    }
     if (file.compressed) {
         config.decompress = file.compressed;
     }
     
     auto loader = std::make_unique<FileDataLoader>(file.filename, config);
     loaders_.push_back(std::move(loader));
+}
+
+void MultiFileReader::addFile(const FileEntry& file) {
+    // Check if file already exists
+    auto it = std::find_if(files_.begin(), files_.end(),
+        [&](const FileEntry& entry) { return entry.filename == file.filename; });
+    
+    if (it != files_.end()) {
+        throw std::runtime_error("File already exists: " + file.filename);
+    }
+    
+    files_.push_back(file);
+    openFile(file);
     
     fillQueue();
 }
@@ -63,6 +64,10 @@ void MultiFileReader::removeFile(const std::string& filename) {
     
     size_t index = file_it - files_.begin();
     
+    if (file_it->follow) {
+        follower_->remove(filename);
+        follow_parsers_.erase(filename);
+    }
     files_.erase(file_it);
     loaders_.erase(loaders_.begin() + index);
     
@@ -89,6 +94,9 @@ void MultiFileReader::removeFile(const std::string& filename) {
 std::optional<LogParser::LogEntry> MultiFileReader::nextEntry() {
     if (entry_queue_.empty()) {
         fillQueue();
+        if (entry_queue_.empty() && follower_->size() > 0) {
+            poll(0);
+        }
         if (entry_queue_.empty()) {
             return std::nullopt;
         }
@@ -100,6 +108,12 @@ std::optional<LogParser::LogEntry> MultiFileReader::nextEntry() {
     entries_read_++;
     bytes_read_ += entry.entry.message.size();
     
+    // Followed files queue their entries as they are polled
+    if (!loaders_[entry.file_index]) {
+        follower_->commit(files_[entry.file_index].filename, entry.position);
+        return entry.entry;
+    }
+    
     // Try to read next entry from the same file
     // Use loadData or streamData instead of nextEntry which doesn't exist in FileDataLoader
     LogParser::LogEntry next_log_entry;
@@ -130,9 +144,14 @@ bool MultiFileReader::hasMore() const {
         return true;
     }
     
+    // A followed file may always grow
+    if (follower_->size() > 0) {
+        return true;
+    }
+    
     for (const auto& loader : loaders_) {
         // Use get_progress() to check if there's more data
-        if (loader->get_progress() < 1.0) {
+        if (loader && loader->get_progress() < 1.0) {
             return true;
         }
     }
@@ -140,6 +159,39 @@ bool MultiFileReader::hasMore() const {
     return false;
 }
 
+size_t MultiFileReader::poll(int timeout_ms) {
+    size_t queued = 0;
+    std::string line_buffer;
+    follower_->poll(timeout_ms, [&](const std::string& path, std::string_view line,
+                                    const FileFollower::Position& end) {
+        auto file_it = std::find_if(files_.begin(), files_.end(),
+            [&](const FileEntry& entry) { return entry.filename == path; });
+        auto parser_it = follow_parsers_.find(path);
+        if (file_it == files_.end() || parser_it == follow_parsers_.end() || !parser_it->second) {
+            follower_->commit(path, end);
+            return;
+        }
+        
+        line_buffer.assign(line);
+        if (!line_buffer.empty() && line_buffer.back() == '\r') {
+            line_buffer.pop_back();
+        }
+        if (!parser_it->second->validate(line_buffer)) {
+            // Nothing will be queued for this line, so it is consumed now
+            follower_->commit(path, end);
+            return;
+        }
+        
+        QueueEntry queue_entry;
+        queue_entry.entry = parser_it->second->parse(line_buffer);
+        queue_entry.file_index = file_it - files_.begin();
+        queue_entry.position = end;
+        entry_queue_.push(std::move(queue_entry));
+        queued++;
+    });
+    return queued;
+}
+
 std::vector<MultiFileReader::FileEntry> MultiFileReader::getFiles() const {
     return files_;
 }
@@ -154,6 +206,9 @@ size_t MultiFileReader::getBytesRead() const {
 
 void MultiFileReader::fillQueue() {
     for (size_t i = 0; i < loaders_.size(); ++i) {
+        if (!loaders_[i]) {
+            continue;
+        }
         // Check if there are potentially more entries to read
         if (entry_queue_.empty() || loaders_[i]->get_progress() < 1.0) {
             // Use loadData to get entries instead of nextEntry
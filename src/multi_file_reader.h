@@ -3,8 +3,11 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <queue>
+#include <unordered_map>
 #include "file_data_loader.h"
+#include "file_follower.h"
 
 namespace logai {
 
@@ -17,8 +20,11 @@ public:
         bool compressed;
     };
     
-    // Initialize with a list of files to read
-    explicit MultiFileReader(const std::vector<FileEntry>& files);
+    // Initialize with a list of files to read. Offsets of followed files are
+    // checkpointed to checkpoint_path, if given, so a restart resumes them
+    // at the oldest line nextEntry() has not returned yet.
+    explicit MultiFileReader(const std::vector<FileEntry>& files,
+                             const std::string& checkpoint_path = "");
     
     // Add a new file to read
     void addFile(const FileEntry& file);
@@ -29,9 +35,13 @@ public:
     // Get next log entry from any file, ordered by timestamp
     std::optional<LogParser::LogEntry> nextEntry();
     
-    // Check if there are more entries to read
+    // Check if there are more entries to read (always true while following)
     bool hasMore() const;
     
+    // Wait up to timeout_ms for lines appended to followed files and queue
+    // them; returns the number of entries queued
+    size_t poll(int timeout_ms);
+    
     // Get list of current files
     std::vector<FileEntry> getFiles() const;
     
@@ -45,6 +55,7 @@ private:
     struct QueueEntry {
         LogParser::LogEntry entry;
         size_t file_index;
+        FileFollower::Position position;  // Committed when a followed entry is returned
         
         bool operator>(const QueueEntry& other) const {
             return entry.timestamp > other.entry.timestamp;
@@ -52,13 +63,18 @@ private:
     };
     
     std::vector<FileEntry> files_;
-    std::vector<std::unique_ptr<FileDataLoader>> loaders_;
+    std::vector<std::unique_ptr<FileDataLoader>> loaders_;  // nullptr for followed files
+    std::unique_ptr<FileFollower> follower_;
+    std::unordered_map<std::string, std::unique_ptr<LogParser>> follow_parsers_;
     std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<>> entry_queue_;
     size_t entries_read_ = 0;
     size_t bytes_read_ = 0;
     
     // Fill the queue with next entries from files
     void fillQueue();
+    
+    // Create the loader for a file, or hand it to the follower
+    void openFile(const FileEntry& file);
 };
 
 } // namespace logai 
\ No newline at end of file
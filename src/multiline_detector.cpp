@@ -0,0 +1,106 @@
+#include "multiline_detector.h"
+#include "log_prefix_matcher.h"
+
+#include <cctype>
+
+namespace logai {
+
+namespace {
+
+constexpr std::string_view kMonths[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+std::string_view trim_right(std::string_view line) {
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+} // namespace
+
+MultilineDetector::MultilineDetector(MultilineRules rules) : rules_(std::move(rules)) {
+    if (!rules_.start_pattern.empty()) {
+        start_regex_ = std::regex(rules_.start_pattern, std::regex::optimize);
+    }
+    if (rules_.max_lines == 0) {
+        rules_.max_lines = 1;
+    }
+}
+
+bool MultilineDetector::is_blank(std::string_view line) {
+    return trim_right(line).empty();
+}
+
+bool MultilineDetector::continues(std::string_view line, std::string_view previous) const {
+    if (is_blank(line) || is_blank(previous)) {
+        return false;
+    }
+    if (rules_.backslash_continues && trim_right(previous).back() == '\\') {
+        return true;
+    }
+    if (!rules_.start_pattern.empty()) {
+        return !std::regex_search(line.begin(), line.end(), start_regex_,
+                                  std::regex_constants::match_continuous);
+    }
+    if (rules_.timestamp_start) {
+        return !starts_with_timestamp(line);
+    }
+    if (rules_.indent_continues) {
+        // Java puts "Caused by:" at the start of the line, unlike the frames
+        return line[0] == ' ' || line[0] == '\t' || line.rfind("Caused by:", 0) == 0;
+    }
+    return false;
+}
+
+bool MultilineDetector::starts_with_timestamp(std::string_view line) {
+    if (!line.empty() && line[0] == '[') {
+        line.remove_prefix(1);
+    }
+    // 2024-03-24 / 2024/03/24 (any time or separator after it)
+    if (line.size() >= 6 && is_digit(line[0]) && is_digit(line[1]) && is_digit(line[2]) &&
+        is_digit(line[3]) && (line[4] == '-' || line[4] == '/') && is_digit(line[5])) {
+        return true;
+    }
+    // 10:15:30
+    size_t hour = 0;
+    while (hour < line.size() && hour < 2 && is_digit(line[hour])) {
+        ++hour;
+    }
+    if (hour > 0 && line.size() >= hour + 3 && line[hour] == ':' &&
+        is_digit(line[hour + 1]) && is_digit(line[hour + 2])) {
+        return true;
+    }
+    // Mar 24 10:15:30 (syslog)
+    for (std::string_view month : kMonths) {
+        if (line.rfind(month, 0) == 0 && line.size() > 4 && line[3] == ' ' &&
+            (is_digit(line[4]) || line[4] == ' ')) {
+            return true;
+        }
+    }
+    // Mon Mar 24 10:15:30 2024
+    return LogPrefixMatcher::match_ctime(line) > 0;
+}
+
+void MultilineDetector::append(std::string& record, std::string_view line) {
+    std::string_view trimmed = trim_right(record);
+    if (!trimmed.empty() && trimmed.back() == '\\') {
+        record.resize(trimmed.size() - 1);
+        record.resize(trim_right(record).size());
+        record.append(line);
+        return;
+    }
+    size_t indent = 0;
+    while (indent < line.size() && (line[indent] == ' ' || line[indent] == '\t')) {
+        ++indent;
+    }
+    record.push_back(' ');
+    record.append(line.substr(indent));
+}
+
+} // namespace logai
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <regex>
+#include <string>
+#include <string_view>
+
+namespace logai {
+
+/**
+ * @brief Rules for where a multi-line log record (stack trace, continued
+ * line) begins.
+ */
+struct MultilineRules {
+    // A record begins at every line matching this regex (anchored at the
+    // line start); other lines continue the previous record. Empty: use the
+    // timestamp or indentation rule.
+    std::string start_pattern;
+    // A record begins at every line starting with a date or time; other
+    // lines continue the previous record. Ignored if start_pattern is set.
+    bool timestamp_start = false;
+    // Otherwise lines starting with whitespace or "Caused by:" continue
+    // the previous record
+    bool indent_continues = true;
+    // A line ending in a backslash continues onto the next one
+    bool backslash_continues = true;
+    // Records longer than this are split, so a missed boundary cannot
+    // swallow the rest of the file into one record
+    size_t max_lines = 1000;
+};
+
+/**
+ * @brief Assembles multi-line records from lines.
+ *
+ * Whether a line continues a record depends only on the line and the one
+ * before it, so a file split at newlines can be assembled range by range in
+ * parallel: a range owns the records whose first line starts inside it,
+ * skips continuation lines at its start (they finish the previous range's
+ * record) and reads past its end to finish its own last record.
+ */
+class MultilineDetector {
+public:
+    explicit MultilineDetector(MultilineRules rules = MultilineRules());
+
+    /** Whether `line` continues the record that `previous` belongs to. */
+    bool continues(std::string_view line, std::string_view previous) const;
+
+    /** Whether `line` starts with a date or time, optionally in brackets. */
+    static bool starts_with_timestamp(std::string_view line);
+
+    /**
+     * Join continuation `line` onto `record` the way logical lines have
+     * always been joined: drop a trailing backslash, else join with a space.
+     */
+    static void append(std::string& record, std::string_view line);
+
+    /**
+     * @brief Assemble the records whose first line starts in [begin, end).
+     *
+     * `begin` must be 0 or follow a newline. on_record(record, copied) is
+     * called for each record. A single-line record is a view into `data`.
+     * A joined one (`copied`) lives in a scratch buffer that is only valid
+     * for the duration of the call. Blank lines end a record and are
+     * skipped.
+     *
+     * @return size_t Number of records passed to on_record
+     */
+    template <typename Fn>
+    size_t for_each_record(const char* data, size_t size, size_t begin, size_t end,
+                           Fn&& on_record) const {
+        auto line_at = [&](size_t pos) {
+            const void* newline = std::memchr(data + pos, '\n', size - pos);
+            size_t line_end = newline ? static_cast<const char*>(newline) - data : size;
+            return std::string_view(data + pos, line_end - pos);
+        };
+
+        std::string_view previous;
+        if (begin > 0) {
+            size_t line_start = begin - 1;
+            while (line_start > 0 && data[line_start - 1] != '\n') {
+                --line_start;
+            }
+            previous = std::string_view(data + line_start, begin - 1 - line_start);
+        }
+
+        // Lines continuing a record that started before `begin` belong to it
+        size_t pos = begin;
+        while (pos < end) {
+            std::string_view line = line_at(pos);
+            if (!continues(line, previous)) {
+                break;
+            }
+            previous = line;
+            pos += line.size() + 1;
+        }
+
+        size_t records = 0;
+        bool split = false;  // The last record hit max_lines; its rest is ours too
+        std::string joined;
+        while (pos < size && (pos < end || split)) {
+            std::string_view first = line_at(pos);
+            pos += first.size() + 1;
+            split = false;
+            if (is_blank(first)) {
+                previous = first;
+                continue;
+            }
+
+            std::string_view last = first;
+            size_t lines = 1;
+            bool copied = false;
+            while (pos < size) {
+                std::string_view line = line_at(pos);
+                if (!continues(line, last)) {
+                    break;
+                }
+                if (lines >= rules_.max_lines) {
+                    split = true;
+                    break;
+                }
+                if (!copied) {
+                    joined.assign(first);
+                    copied = true;
+                }
+                append(joined, line);
+                last = line;
+                lines++;
+                pos += line.size() + 1;
+            }
+            on_record(copied ? std::string_view(joined) : first, copied);
+            records++;
+            previous = last;
+        }
+        return records;
+    }
+
+private:
+    static bool is_blank(std::string_view line);
+
+    MultilineRules rules_;
+    std::regex start_regex_;
+};
+
+} // namespace logai
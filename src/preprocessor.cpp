@@ -1,4 +1,5 @@
 #include "preprocessor.h"
+#include "thread_pool.h"
 #include <memory>
 #include <thread>
 #include <algorithm>
@@ -203,17 +204,8 @@ Preprocessor::clean_log_batch(const std::vector<std::string>& loglines) {
     };
     
     if (num_threads > 1 && num_lines > 1000) {
-        // Use parallel processing for large batches
-        std::vector<std::thread> threads;
-        for (size_t t = 0; t < num_threads; ++t) {
-            size_t start = t * batch_size;
-            size_t end = std::min(start + batch_size, num_lines);
-            threads.emplace_back(process_range, start, end);
-        }
-        
-        for (auto& thread : threads) {
-            thread.join();
-        }
+        // Use parallel processing for large batches, on the shared pool
+        ThreadPool::instance().parallel_for(0, num_lines, batch_size, process_range);
     } else {
         // Use single-threaded processing for small batches
         process_range(0, num_lines);
@@ -259,17 +251,8 @@ Preprocessor::clean_log_batch_simd(const std::vector<std::string>& loglines) {
     };
     
     if (num_threads > 1 && num_lines > 1000) {
-        // Use parallel processing for large batches
-        std::vector<std::thread> threads;
-        for (size_t t = 0; t < num_threads; ++t) {
-            size_t start = t * batch_size;
-            size_t end = std::min(start + batch_size, num_lines);
-            threads.emplace_back(process_range, start, end);
-        }
-        
-        for (auto& thread : threads) {
-            thread.join();
-        }
+        // Use parallel processing for large batches, on the shared pool
+        ThreadPool::instance().parallel_for(0, num_lines, batch_size, process_range);
     } else {
         // Use single-threaded processing for small batches
         process_range(0, num_lines);
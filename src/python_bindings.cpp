@@ -3,6 +3,7 @@
 #include <nlohmann/json.hpp>
 #include "drain_parser.h"
 #include "file_data_loader.h"
+#include "thread_pool.h"
 #include "log_parser.h"
 #include "gemini_vectorizer.h"
 #include <curl/curl.h>
@@ -46,13 +47,15 @@ std::vector<float> generate_template_embedding(const std::string& template_text)
     }
 }
 
-// Function to parse a log file and return parsed records
-py::list parse_log_file(const std::string& file_path, const std::string& format = "") {
+// Function to parse a log file and return parsed records; with incremental,
+// only the records appended since the last call on the same file
+py::list parse_log_file(const std::string& file_path, const std::string& format = "", bool incremental = false) {
     try {
         // Create file data loader with appropriate configuration
         logai::FileDataLoaderConfig config;
         config.format = format.empty() ? "logfmt" : format;
         config.encoding = "utf-8";
+        config.incremental = incremental;
         
         logai::FileDataLoader loader(file_path, config);
         
@@ -190,17 +193,54 @@ py::dict extract_attributes(const std::vector<std::string>& log_lines, const std
     }
 }
 
+// Function to read a page of raw lines through the file's line index
+py::dict read_log_lines(const std::string& file_path, size_t start, size_t count) {
+    py::dict result;
+    try {
+        logai::FileDataLoaderConfig config;
+        logai::FileDataLoader loader(file_path, config);
+
+        py::list lines;
+        for (const auto& line : loader.read_lines(start, count)) {
+            lines.append(line);
+        }
+        result["lines"] = lines;
+        result["total_lines"] = loader.line_count();
+    } catch (const std::exception& e) {
+        py::print("Error reading log lines:", e.what());
+        result["lines"] = py::list();
+        result["total_lines"] = 0;
+    }
+    return result;
+}
+
+// Function to size the shared worker pool before the first parallel call
+bool configure_thread_pool(size_t num_threads, bool pin_threads) {
+    logai::ThreadPool::Options options;
+    options.num_threads = num_threads;
+    options.pin_threads = pin_threads;
+    return logai::ThreadPool::configure(options);
+}
+
 PYBIND11_MODULE(logai_cpp, m) {
     m.doc() = "LogAI C++ Module for Log Parsing and Analysis";
     
     // Parser functions
     m.def("parse_log_file", &parse_log_file, "Parse a log file and return parsed records",
-          py::arg("file_path"), py::arg("format") = "");
+          py::arg("file_path"), py::arg("format") = "", py::arg("incremental") = false);
     
     m.def("process_large_file_with_callback", &process_large_file_with_callback,
           "Process a large log file with a callback function for each batch of records",
           py::arg("file_path"), py::arg("format"), py::arg("callback"), py::arg("chunk_size") = 10000);
     
+    m.def("read_log_lines", &read_log_lines,
+          "Read a page of raw lines from a log file using its persisted line index",
+          py::arg("file_path"), py::arg("start") = 0, py::arg("count") = 100);
+    
+    m.def("configure_thread_pool", &configure_thread_pool,
+          "Set the size and CPU pinning of the shared worker pool; returns False if it is already running",
+          py::arg("num_threads") = 0, py::arg("pin_threads") = false);
+    
     // Attribute extraction
     m.def("extract_attributes", &extract_attributes, "Extract attributes from log lines using regex patterns",
           py::arg("log_lines"), py::arg("patterns"));
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <folly/synchronization/AtomicNotification.h>
+
+namespace logai {
+
+/**
+ * @brief Puts out-of-order results back into sequence.
+ *
+ * Results numbered 0, 1, 2, ... may be put() from any thread in any order;
+ * a single consumer pop()s them strictly in sequence, waking as soon as the
+ * next one arrives. Storage is a fixed ring of `window` slots indexed by
+ * `sequence % window`, and wait_for_room() holds back the producer of
+ * `sequence` until it fits in the window, so at most `window` results are
+ * ever outstanding no matter how long one slow result takes.
+ *
+ * Waits sleep on futex words (folly::atomic_wait), like BoundedQueue.
+ */
+template<typename T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window)
+        : window_(window > 0 ? window : 1),
+          slots_(new Slot[window_]) {}
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+    /**
+     * @brief Wait until `sequence` may be put.
+     *
+     * `idle()` is called before each sleep; it returns true if it did some
+     * useful work (then the window is checked again without sleeping).
+     *
+     * @return bool False if cancel() was called
+     */
+    template<typename Idle>
+    bool wait_for_room(size_t sequence, Idle&& idle) {
+        while (!cancelled_.load()) {
+            if (sequence < next_.load(std::memory_order_acquire) + window_) {
+                return true;
+            }
+            if (idle()) {
+                continue;
+            }
+            uint32_t epoch = departures_.load();
+            producer_waiting_.fetch_add(1);
+            if (sequence >= next_.load(std::memory_order_acquire) + window_ && !cancelled_.load()) {
+                folly::atomic_wait(&departures_, epoch);
+            }
+            producer_waiting_.fetch_sub(1);
+        }
+        return false;
+    }
+
+    /** Store result `sequence`; wait_for_room(sequence) must have returned true. */
+    void put(size_t sequence, T value) {
+        Slot& slot = slots_[sequence % window_];
+        slot.value = std::move(value);
+        slot.ready.store(true, std::memory_order_release);
+        signal(arrivals_, consumer_waiting_);
+    }
+
+    /**
+     * @brief Take the next result in sequence, waiting for it to arrive.
+     *
+     * @return bool False once every result before finish()'s count is taken
+     */
+    bool pop(T& value) {
+        const size_t sequence = next_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[sequence % window_];
+        while (!slot.ready.load(std::memory_order_acquire)) {
+            if (sequence >= end_.load()) {
+                return false;
+            }
+            uint32_t epoch = arrivals_.load();
+            consumer_waiting_.fetch_add(1);
+            if (!slot.ready.load(std::memory_order_acquire) && sequence < end_.load()) {
+                folly::atomic_wait(&arrivals_, epoch);
+            }
+            consumer_waiting_.fetch_sub(1);
+        }
+        value = std::move(slot.value);
+        slot.ready.store(false, std::memory_order_relaxed);
+        // Publishes the emptied slot to the producer's next wait_for_room
+        next_.store(sequence + 1, std::memory_order_release);
+        signal(departures_, producer_waiting_);
+        return true;
+    }
+
+    /** No result numbered `count` or higher will be put. */
+    void finish(size_t count) {
+        end_.store(count);
+        arrivals_.fetch_add(1);
+        folly::atomic_notify_all(&arrivals_);
+    }
+
+    /** Release a producer waiting for room, e.g. because the consumer failed. */
+    void cancel() {
+        cancelled_.store(true);
+        departures_.fetch_add(1);
+        folly::atomic_notify_all(&departures_);
+    }
+
+    /** Number of results popped so far. */
+    size_t next() const {
+        return next_.load(std::memory_order_acquire);
+    }
+
+    size_t window() const {
+        return window_;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<bool> ready{false};
+        T value;
+    };
+
+    static void signal(std::atomic<uint32_t>& events, std::atomic<uint32_t>& waiting) {
+        events.fetch_add(1);
+        if (waiting.load() != 0) {
+            folly::atomic_notify_all(&events);
+        }
+    }
+
+    const size_t window_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<size_t> next_{0};
+    std::atomic<size_t> end_{std::numeric_limits<size_t>::max()};
+
+    // Futex words: `arrivals_` advances on every put (and finish()),
+    // `departures_` on every pop (and cancel())
+    alignas(64) std::atomic<uint32_t> arrivals_{0};
+    std::atomic<uint32_t> consumer_waiting_{0};
+    alignas(64) std::atomic<uint32_t> departures_{0};
+    std::atomic<uint32_t> producer_waiting_{0};
+    std::atomic<bool> cancelled_{false};
+};
+
+} // namespace logai
@@ -0,0 +1,289 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <folly/synchronization/AtomicNotification.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace logai {
+
+namespace {
+
+// Index of the current thread's worker in `current_pool`
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+std::mutex instance_mutex;
+ThreadPool::Options instance_options;
+std::unique_ptr<ThreadPool> instance_pool;
+
+void pin_to_cpu([[maybe_unused]] size_t index) {
+#ifdef __linux__
+    unsigned cpus = std::max(1U, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        spdlog::warn("Could not pin pool worker {} to a CPU", index);
+    }
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(const Options& options)
+    : injection_(std::max<size_t>(options.injection_capacity, 2)) {
+    size_t num_threads = options.num_threads > 0 ?
+                        options.num_threads :
+                        std::max(1U, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    // Start workers only once every queue exists, since they steal from all
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.emplace_back([this, i, pin = options.pin_threads]() {
+            if (pin) {
+                pin_to_cpu(i);
+            }
+            worker_loop(i);
+        });
+    }
+    spdlog::info("Thread pool started with {} workers", num_threads);
+}
+
+ThreadPool::~ThreadPool() {
+    stopping_.store(true);
+    work_epoch_.fetch_add(1);
+    folly::atomic_notify_all(&work_epoch_);
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::instance() {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (!instance_pool) {
+        instance_pool = std::make_unique<ThreadPool>(instance_options);
+    }
+    return *instance_pool;
+}
+
+bool ThreadPool::configure(const Options& options) {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (instance_pool) {
+        spdlog::warn("Thread pool already started; configuration ignored");
+        return false;
+    }
+    instance_options = options;
+    return true;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (current_pool == this) {
+        auto& queue = *queues_[current_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    } else {
+        while (!injection_.try_push(task)) {
+            if (!run_one()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    wake_one();
+}
+
+bool ThreadPool::run_one() {
+    std::function<void()> task;
+    size_t self = current_pool == this ? current_index : queues_.size();
+    if (!find_task(self, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain,
+                              const std::function<void(size_t, size_t)>& fn) {
+    grain = std::max<size_t>(grain, 1);
+    if (end <= begin) {
+        return;
+    }
+    if (end - begin <= grain) {
+        fn(begin, end);
+        return;
+    }
+    TaskGroup group(*this);
+    // Keep the first chunk for the calling thread
+    for (size_t start = begin + grain; start < end; start += grain) {
+        size_t stop = std::min(start + grain, end);
+        group.run([&fn, start, stop]() { fn(start, stop); });
+    }
+    fn(begin, std::min(begin + grain, end));
+    group.wait();
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    std::function<void()> task;
+    while (!stopping_.load()) {
+        if (find_task(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        uint32_t epoch = work_epoch_.load();
+        sleepers_.fetch_add(1);
+        // Re-check after registering so a submit in between cannot be missed
+        if (find_task(index, task)) {
+            sleepers_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+        if (!stopping_.load()) {
+            folly::atomic_wait(&work_epoch_, epoch);
+        }
+        sleepers_.fetch_sub(1);
+    }
+}
+
+bool ThreadPool::find_task(size_t self, std::function<void()>& task) {
+    // Own work first, newest first
+    if (self < queues_.size()) {
+        auto& queue = *queues_[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    if (injection_.try_pop(task)) {
+        return true;
+    }
+
+    // Steal the oldest task from another worker, starting past ourselves so
+    // thieves spread out
+    const size_t n = queues_.size();
+    for (size_t i = 1; i <= n; ++i) {
+        size_t victim = (self + i) % n;
+        if (victim == self) {
+            continue;
+        }
+        auto& queue = *queues_[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::wake_one() {
+    work_epoch_.fetch_add(1);
+    if (sleepers_.load() != 0) {
+        folly::atomic_notify_one(&work_epoch_);
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+    : pool_(pool), state_(std::make_shared<State>()) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (const std::exception& e) {
+        spdlog::error("Unhandled task error: {}", e.what());
+    } catch (...) {
+        spdlog::error("Unhandled task error");
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    state_->pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(state_->queue_mutex);
+        state_->queue.push_back(std::move(task));
+    }
+    // One pool task per queued task; whoever gets to a task first runs it,
+    // so this finds the queue empty if a waiter already has
+    pool_.submit([state = state_]() { run_next(*state); });
+}
+
+bool TaskGroup::run_next(State& state) {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(state.queue_mutex);
+        if (state.queue.empty()) {
+            return false;
+        }
+        // Oldest first: callers usually wait on the earliest results
+        task = std::move(state.queue.front());
+        state.queue.pop_front();
+    }
+    try {
+        task();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(state.error_mutex);
+        if (!state.error) {
+            state.error = std::current_exception();
+        }
+    }
+    state.pending.fetch_sub(1);
+    if (state.waiters.load() != 0) {
+        folly::atomic_notify_all(&state.pending);
+    }
+    return true;
+}
+
+bool TaskGroup::run_one() {
+    return run_next(*state_);
+}
+
+void TaskGroup::wait() {
+    wait_below(1);
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(state_->error_mutex);
+        std::swap(error, state_->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void TaskGroup::wait_below(size_t limit) {
+    limit = std::max<size_t>(limit, 1);
+    while (true) {
+        uint32_t pending = state_->pending.load();
+        if (pending < limit) {
+            return;
+        }
+        // Help with this group's own tasks instead of blocking
+        if (run_next(*state_)) {
+            continue;
+        }
+        state_->waiters.fetch_add(1);
+        if (state_->pending.load() == pending) {
+            folly::atomic_wait(&state_->pending, pending);
+        }
+        state_->waiters.fetch_sub(1);
+    }
+}
+
+size_t TaskGroup::pending() const {
+    return state_->pending.load();
+}
+
+} // namespace logai
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+
+namespace logai {
+
+/**
+ * @brief Process-wide work-stealing executor.
+ *
+ * Every worker owns a deque: tasks it submits go to the back and it takes
+ * work from the back (newest first, still cache-warm), while idle workers
+ * steal from the front of other deques. Tasks submitted from outside the
+ * pool go through a bounded injection queue. Idle workers sleep on a futex
+ * word and are only woken when there are sleepers to wake.
+ *
+ * The library submits all of its parallel work here (file loading,
+ * preprocessing) so repeated or concurrent calls share one set of threads
+ * instead of each spawning hardware_concurrency() of their own.
+ */
+class ThreadPool {
+public:
+    struct Options {
+        size_t num_threads = 0;     // 0 = std::thread::hardware_concurrency()
+        bool pin_threads = false;   // Pin worker i to CPU i (Linux only)
+        size_t injection_capacity = 4096;
+    };
+
+    explicit ThreadPool(const Options& options);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief The shared pool, started on first use.
+     */
+    static ThreadPool& instance();
+
+    /**
+     * @brief Set the options the shared pool is started with.
+     *
+     * @return bool False if the shared pool is already running (options unchanged)
+     */
+    static bool configure(const Options& options);
+
+    size_t size() const { return workers_.size(); }
+
+    /**
+     * @brief Queue a task. Never blocks a pool worker; an outside caller
+     * helps run tasks while the injection queue is full.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Run one pending task on the calling thread.
+     *
+     * @return bool False if no task was available
+     */
+    bool run_one();
+
+    /**
+     * @brief Call fn(chunk_begin, chunk_end) over [begin, end) in chunks of
+     * `grain`, on the pool and the calling thread, and wait for all of them.
+     */
+    void parallel_for(size_t begin, size_t end, size_t grain,
+                      const std::function<void(size_t, size_t)>& fn);
+
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void worker_loop(size_t index);
+    bool find_task(size_t self, std::function<void()>& task);
+    void wake_one();
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    BoundedQueue<std::function<void()>> injection_;
+    std::vector<std::thread> workers_;
+
+    alignas(64) std::atomic<uint32_t> work_epoch_{0};
+    std::atomic<uint32_t> sleepers_{0};
+    std::atomic<bool> stopping_{false};
+};
+
+/**
+ * @brief A set of tasks on a ThreadPool that can be waited for together.
+ *
+ * Waiting threads run the group's own not yet started tasks instead of
+ * blocking, so a task may itself start and wait for a nested group. They
+ * never pick up unrelated pool work, which could keep a waiter busy long
+ * after its own tasks are done. The first exception thrown by a task is
+ * rethrown from wait().
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+
+    /** Wait until every task has finished. */
+    void wait();
+
+    /** Wait until fewer than `limit` tasks are unfinished (limit >= 1). */
+    void wait_below(size_t limit);
+
+    /**
+     * @brief Run one of this group's tasks on the calling thread.
+     *
+     * @return bool False if every task has already been started
+     */
+    bool run_one();
+
+    size_t pending() const;
+
+private:
+    // Shared with running tasks so a task can finish after the group's
+    // waiter has returned and destroyed the group
+    struct State {
+        std::atomic<uint32_t> pending{0};
+        std::atomic<uint32_t> waiters{0};
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        std::mutex queue_mutex;
+        std::deque<std::function<void()>> queue;  // Tasks not yet started
+    };
+
+    static bool run_next(State& state);
+
+    ThreadPool& pool_;
+    std::shared_ptr<State> state_;
+};
+
+} // namespace logai
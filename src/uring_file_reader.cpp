@@ -0,0 +1,474 @@
+#include "uring_file_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <folly/synchronization/AtomicNotification.h>
+#include <spdlog/spdlog.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace logai {
+
+namespace {
+
+constexpr size_t kBufferAlignment = 4096;
+
+struct FreeDeleter {
+    void operator()(char* p) const { std::free(p); }
+};
+
+} // namespace
+
+/**
+ * Read buffers, shared with the blocks handed out so they outlive the
+ * reader if callers keep blocks longer.
+ */
+struct UringFileReader::BufferPool {
+    BufferPool(size_t count, size_t block_size)
+        : block_size(block_size),
+          memory(static_cast<char*>(std::aligned_alloc(kBufferAlignment, count * block_size))) {
+        for (size_t i = count; i > 0; --i) {
+            free.push_back(i - 1);
+        }
+    }
+
+    char* buffer(size_t index) { return memory.get() + index * block_size; }
+
+    bool try_take(size_t& index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free.empty()) {
+            return false;
+        }
+        index = free.back();
+        free.pop_back();
+        return true;
+    }
+
+    bool any_free() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !free.empty();
+    }
+
+    void give_back(size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free.push_back(index);
+        }
+        releases.fetch_add(1);
+        if (waiting.load() != 0) {
+            folly::atomic_notify_all(&releases);
+        }
+    }
+
+    const size_t block_size;
+    std::unique_ptr<char, FreeDeleter> memory;
+    std::mutex mutex;
+    std::vector<size_t> free;
+    std::atomic<uint32_t> releases{0};
+    std::atomic<uint32_t> waiting{0};
+};
+
+#ifdef __linux__
+
+/**
+ * Minimal io_uring wrapper over the raw system calls: one submission and
+ * one completion ring, mapped as the kernel describes in io_uring_params.
+ */
+class UringFileReader::Ring {
+public:
+    ~Ring() {
+        if (sqes_ != MAP_FAILED) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+            munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_ != MAP_FAILED) {
+            munmap(sq_ring_, sq_ring_size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params{};
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return false;
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            return false;
+        }
+        cq_ring_ = single_mmap ? sq_ring_
+                               : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            return false;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) {
+            return false;
+        }
+
+        auto* sq = static_cast<char*>(sq_ring_);
+        sq_tail_ = reinterpret_cast<std::atomic<uint32_t>*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<std::atomic<uint32_t>*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<std::atomic<uint32_t>*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool register_buffers(const std::vector<iovec>& buffers) {
+        registered_ = syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                              buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+        return registered_;
+    }
+
+    /** Queue a read at file `offset` into `target`, part of pool buffer `buffer`. */
+    void prepare_read(int fd, const iovec& target, size_t buffer, uint64_t offset, uint64_t user_data) {
+        uint32_t tail = sq_tail_->load(std::memory_order_relaxed);
+        uint32_t index = tail & sq_mask_;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.fd = fd;
+        sqe.off = offset;
+        sqe.addr = reinterpret_cast<uint64_t>(target.iov_base);
+        sqe.len = static_cast<uint32_t>(target.iov_len);
+        sqe.user_data = user_data;
+        if (registered_) {
+            sqe.opcode = IORING_OP_READ_FIXED;
+            sqe.buf_index = static_cast<uint16_t>(buffer);
+        } else {
+            // Plain reads need no locked memory (RLIMIT_MEMLOCK) but pin
+            // the pages on every request
+            sqe.opcode = IORING_OP_READV;
+            sqe.addr = reinterpret_cast<uint64_t>(&target);
+            sqe.len = 1;
+        }
+        sq_array_[index] = index;
+        sq_tail_->store(tail + 1, std::memory_order_release);
+        unsubmitted_++;
+    }
+
+    /** Submit queued reads and wait for at least `wait` completions. */
+    bool enter(unsigned wait) {
+        while (true) {
+            long ret = syscall(__NR_io_uring_enter, fd_, unsubmitted_, wait,
+                               wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (ret >= 0) {
+                unsubmitted_ -= static_cast<unsigned>(ret);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN) {
+                return false;
+            }
+        }
+    }
+
+    /** Take one completion if any is ready. */
+    bool pop(uint64_t& user_data, int32_t& result) {
+        uint32_t head = cq_head_->load(std::memory_order_relaxed);
+        if (head == cq_tail_->load(std::memory_order_acquire)) {
+            return false;
+        }
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        user_data = cqe.user_data;
+        result = cqe.res;
+        cq_head_->store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    void* sq_ring_ = MAP_FAILED;
+    void* cq_ring_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    size_t sqes_size_ = 0;
+    std::atomic<uint32_t>* sq_tail_ = nullptr;
+    uint32_t sq_mask_ = 0;
+    uint32_t* sq_array_ = nullptr;
+    std::atomic<uint32_t>* cq_head_ = nullptr;
+    std::atomic<uint32_t>* cq_tail_ = nullptr;
+    uint32_t cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned unsubmitted_ = 0;
+    bool registered_ = false;
+};
+
+#else
+
+class UringFileReader::Ring {};
+
+#endif
+
+UringFileReader::UringFileReader(Options options) : options_(options) {
+    options_.block_size = std::max<size_t>(options_.block_size, kBufferAlignment);
+    options_.block_size = (options_.block_size + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment;
+    options_.queue_depth = std::max<size_t>(options_.queue_depth, 1);
+    const size_t count = options_.queue_depth + std::max<size_t>(options_.held_blocks, 1);
+    pool_ = std::make_shared<BufferPool>(count, options_.block_size);
+    if (!pool_->memory) {
+        throw std::bad_alloc();
+    }
+
+#ifdef __linux__
+    auto ring = std::make_unique<Ring>();
+    if (ring->init(static_cast<unsigned>(options_.queue_depth))) {
+        std::vector<iovec> buffers(count);
+        for (size_t i = 0; i < count; ++i) {
+            buffers[i] = {pool_->buffer(i), options_.block_size};
+        }
+        if (!ring->register_buffers(buffers)) {
+            spdlog::debug("io_uring buffer registration failed ({}), using unregistered reads",
+                          std::strerror(errno));
+        }
+        ring_ = std::move(ring);
+    } else {
+        spdlog::info("io_uring unavailable ({}), reading with pread", std::strerror(errno));
+    }
+#endif
+}
+
+UringFileReader::~UringFileReader() = default;
+
+bool UringFileReader::uses_io_uring() const {
+    return ring_ != nullptr;
+}
+
+UringFileReader::Block UringFileReader::make_block(size_t buffer) {
+    std::shared_ptr<BufferPool> pool = pool_;
+    return Block(pool->buffer(buffer), [pool, buffer](const char*) { pool->give_back(buffer); });
+}
+
+void UringFileReader::wait_for_buffer(const std::function<bool()>& idle) {
+    while (!pool_->any_free()) {
+        if (idle()) {
+            continue;
+        }
+        uint32_t epoch = pool_->releases.load();
+        pool_->waiting.fetch_add(1);
+        if (!pool_->any_free()) {
+            folly::atomic_wait(&pool_->releases, epoch);
+        }
+        pool_->waiting.fetch_sub(1);
+    }
+}
+
+bool UringFileReader::read(const std::string& path,
+                           const std::function<void(const Block&, size_t)>& on_block,
+                           const std::function<bool()>& idle) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        spdlog::error("Failed to open file: {}: {}", path, std::strerror(errno));
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+        spdlog::error("Failed to stat file: {}: {}", path, std::strerror(errno));
+        close(fd);
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    const size_t file_size = static_cast<size_t>(sb.st_size);
+    bool ok = ring_ ? read_uring(fd, file_size, on_block, idle)
+                    : read_pread(fd, 0, file_size, on_block, idle);
+    close(fd);
+    if (!ok) {
+        spdlog::error("Failed to read file: {}", path);
+    }
+    return ok;
+}
+
+bool UringFileReader::read_pread(int fd, size_t offset, size_t file_size,
+                                 const std::function<void(const Block&, size_t)>& on_block,
+                                 const std::function<bool()>& idle) {
+    while (offset < file_size) {
+        wait_for_buffer(idle);
+        size_t buffer = 0;
+        if (!pool_->try_take(buffer)) {
+            continue;
+        }
+        Block block = make_block(buffer);
+        char* data = pool_->buffer(buffer);
+        size_t length = std::min(options_.block_size, file_size - offset);
+        size_t filled = 0;
+        while (filled < length) {
+            ssize_t n = pread(fd, data + filled, length - filled, offset + filled);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                // The file shrank while being read
+                file_size = offset + filled;
+                break;
+            }
+            filled += static_cast<size_t>(n);
+        }
+        if (filled > 0) {
+            on_block(block, filled);
+        }
+        offset += filled;
+    }
+    return true;
+}
+
+bool UringFileReader::read_uring(int fd, size_t file_size,
+                                 const std::function<void(const Block&, size_t)>& on_block,
+                                 const std::function<bool()>& idle) {
+#ifdef __linux__
+    // Reads in flight, in file order; completions may arrive in any order
+    // but blocks are handed out from the front only
+    struct Read {
+        size_t buffer;
+        uint64_t offset;
+        size_t length;
+        size_t filled = 0;
+        bool done = false;
+        iovec target{};
+    };
+    std::deque<Read> reads;
+    size_t inflight = 0;
+    uint64_t next_offset = 0;
+    bool failed = false;
+    // Thrown by on_block; rethrown once no read is in flight any more
+    std::exception_ptr error;
+
+    auto submit = [&](Read& read) {
+        read.target = {pool_->buffer(read.buffer) + read.filled, read.length - read.filled};
+        ring_->prepare_read(fd, read.target, read.buffer, read.offset + read.filled,
+                            reinterpret_cast<uint64_t>(&read));
+        inflight++;
+    };
+
+    while (true) {
+        while (!failed && reads.size() < options_.queue_depth && next_offset < file_size) {
+            size_t buffer = 0;
+            if (!pool_->try_take(buffer)) {
+                break;
+            }
+            Read read;
+            read.buffer = buffer;
+            read.offset = next_offset;
+            read.length = std::min<uint64_t>(options_.block_size, file_size - next_offset);
+            reads.push_back(read);
+            submit(reads.back());
+            next_offset += read.length;
+        }
+
+        if (inflight == 0) {
+            if (failed || (reads.empty() && next_offset >= file_size)) {
+                break;
+            }
+            if (reads.empty()) {
+                // Every buffer is held by the caller
+                wait_for_buffer(idle);
+                continue;
+            }
+        } else if (!ring_->enter(1)) {
+            // Completions cannot be reaped. Closing the ring cancels what is
+            // in flight; those buffers are not reused, and from the first
+            // block not yet handed out on, this and later files use pread
+            spdlog::error("io_uring_enter failed ({}), continuing with pread", std::strerror(errno));
+            const uint64_t resume = reads.empty() ? next_offset : reads.front().offset;
+            for (auto& read : reads) {
+                if (read.done) {
+                    make_block(read.buffer);
+                }
+            }
+            reads.clear();
+            ring_.reset();
+            if (failed) {
+                break;
+            }
+            return read_pread(fd, static_cast<size_t>(resume), file_size, on_block, idle);
+        }
+
+        uint64_t user_data = 0;
+        int32_t result = 0;
+        while (ring_->pop(user_data, result)) {
+            inflight--;
+            Read& read = *reinterpret_cast<Read*>(user_data);
+            if (result == -EINTR || result == -EAGAIN) {
+                submit(read);
+            } else if (result < 0) {
+                spdlog::error("Read at offset {} failed: {}", read.offset, std::strerror(-result));
+                failed = true;
+                read.done = true;
+            } else if (result == 0) {
+                // The file shrank while being read
+                read.done = true;
+            } else {
+                read.filled += static_cast<size_t>(result);
+                if (read.filled < read.length) {
+                    // Short read (common on network filesystems): ask for the rest
+                    submit(read);
+                } else {
+                    read.done = true;
+                }
+            }
+        }
+
+        while (!reads.empty() && reads.front().done) {
+            Read& read = reads.front();
+            Block block = make_block(read.buffer);
+            if (!failed && read.filled > 0) {
+                try {
+                    on_block(block, read.filled);
+                } catch (...) {
+                    error = std::current_exception();
+                    failed = true;
+                }
+            }
+            reads.pop_front();
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return !failed;
+#else
+    return read_pread(fd, 0, file_size, on_block, idle);
+#endif
+}
+
+} // namespace logai
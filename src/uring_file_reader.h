@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace logai {
+
+/**
+ * @brief Sequential file reader keeping several fixed-size reads in flight.
+ *
+ * For when memory mapping is off (network filesystems, where page faults
+ * are slow). Reads go through io_uring into a pool of registered buffers,
+ * `queue_depth` at a time, and each filled buffer is handed out in file
+ * order as a reference-counted block so callers can parse straight out of
+ * it; the buffer is reused once the last reference is dropped. Where
+ * io_uring is unavailable (old kernels, seccomp) it falls back to pread().
+ */
+class UringFileReader {
+public:
+    struct Options {
+        size_t block_size = 1 << 20;
+        size_t queue_depth = 8;
+        // Blocks that may be held by callers at once, beyond those in flight
+        size_t held_blocks = 16;
+    };
+
+    using Block = std::shared_ptr<const char>;
+
+    explicit UringFileReader(Options options);
+    UringFileReader() : UringFileReader(Options()) {}
+    ~UringFileReader();
+
+    UringFileReader(const UringFileReader&) = delete;
+    UringFileReader& operator=(const UringFileReader&) = delete;
+
+    /**
+     * @brief Read `path` front to back.
+     *
+     * `on_block(block, size)` is called on this thread for every block in
+     * file order. When every buffer is held by callers, `idle()` is called
+     * before sleeping; it returns true if it did some useful work (such as
+     * handing blocks on so they get released).
+     *
+     * @return bool False if the file could not be opened or read
+     */
+    bool read(const std::string& path,
+              const std::function<void(const Block&, size_t)>& on_block,
+              const std::function<bool()>& idle);
+
+    /** Whether reads go through io_uring rather than the pread() fallback. */
+    bool uses_io_uring() const;
+
+private:
+    struct BufferPool;
+    class Ring;
+
+    bool read_uring(int fd, size_t file_size,
+                    const std::function<void(const Block&, size_t)>& on_block,
+                    const std::function<bool()>& idle);
+    // Reads [offset, file_size)
+    bool read_pread(int fd, size_t offset, size_t file_size,
+                    const std::function<void(const Block&, size_t)>& on_block,
+                    const std::function<bool()>& idle);
+    Block make_block(size_t buffer);
+    void wait_for_buffer(const std::function<bool()>& idle);
+
+    Options options_;
+    std::shared_ptr<BufferPool> pool_;
+    std::unique_ptr<Ring> ring_;
+};
+
+} // namespace logai
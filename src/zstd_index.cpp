@@ -0,0 +1,139 @@
+#include "zstd_index.h"
+
+#include <cstring>
+#include <memory>
+#include <zstd.h>
+
+namespace logai {
+
+namespace {
+
+// Footer of the seekable format's seek table (contrib/seekable_format)
+constexpr uint32_t kSeekableMagic = 0x8F92EAB1;
+constexpr size_t kSeekTableFooterSize = 9;
+constexpr size_t kSkippableHeaderSize = 8;
+constexpr uint8_t kSeekTableChecksumFlag = 0x80;
+
+uint32_t read_le32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool is_skippable(const unsigned char* p, size_t size) {
+    return size >= 4 && (read_le32(p) & ZSTD_MAGIC_SKIPPABLE_MASK) == ZSTD_MAGIC_SKIPPABLE_START;
+}
+
+struct DCtxDeleter {
+    void operator()(ZSTD_DCtx* dctx) const { ZSTD_freeDCtx(dctx); }
+};
+
+} // namespace
+
+bool ZstdIndex::build(const unsigned char* data, size_t size) {
+    frames_.clear();
+    uncompressed_size_ = 0;
+    sizes_known_ = true;
+
+    if (read_seek_table(data, size)) {
+        return true;
+    }
+
+    size_t pos = 0;
+    while (pos < size) {
+        size_t frame_size = ZSTD_findFrameCompressedSize(data + pos, size - pos);
+        if (ZSTD_isError(frame_size)) {
+            frames_.clear();
+            return false;
+        }
+        if (!is_skippable(data + pos, size - pos)) {
+            Frame frame;
+            frame.compressed_offset = pos;
+            frame.compressed_size = frame_size;
+            frame.uncompressed_offset = uncompressed_size_;
+            unsigned long long content = ZSTD_getFrameContentSize(data + pos, size - pos);
+            if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR) {
+                sizes_known_ = false;
+            } else {
+                frame.uncompressed_size = content;
+                uncompressed_size_ += content;
+            }
+            frames_.push_back(frame);
+        }
+        pos += frame_size;
+    }
+    return !frames_.empty();
+}
+
+bool ZstdIndex::read_seek_table(const unsigned char* data, size_t size) {
+    if (size < kSkippableHeaderSize + kSeekTableFooterSize) {
+        return false;
+    }
+    const unsigned char* footer = data + size - kSeekTableFooterSize;
+    if (read_le32(footer + 5) != kSeekableMagic) {
+        return false;
+    }
+    const uint64_t count = read_le32(footer);
+    const size_t entry_size = (footer[4] & kSeekTableChecksumFlag) ? 12 : 8;
+    const uint64_t table_size = count * entry_size + kSeekTableFooterSize;
+    if (table_size + kSkippableHeaderSize > size) {
+        return false;
+    }
+    const unsigned char* table = data + size - table_size - kSkippableHeaderSize;
+    if (!is_skippable(table, kSkippableHeaderSize) || read_le32(table + 4) != table_size) {
+        return false;
+    }
+
+    // Entries list the data frames in order from the start of the file
+    std::vector<Frame> frames;
+    uint64_t compressed = 0;
+    uint64_t uncompressed = 0;
+    const unsigned char* entry = table + kSkippableHeaderSize;
+    for (uint64_t i = 0; i < count; ++i, entry += entry_size) {
+        Frame frame;
+        frame.compressed_offset = compressed;
+        frame.compressed_size = read_le32(entry);
+        frame.uncompressed_offset = uncompressed;
+        frame.uncompressed_size = read_le32(entry + 4);
+        compressed += frame.compressed_size;
+        uncompressed += frame.uncompressed_size;
+        frames.push_back(frame);
+    }
+    if (compressed != static_cast<uint64_t>(table - data)) {
+        return false;
+    }
+
+    frames_ = std::move(frames);
+    uncompressed_size_ = uncompressed;
+    return true;
+}
+
+bool ZstdIndex::extract(const unsigned char* data, size_t size, size_t index,
+                        const std::function<bool(const char*, size_t)>& sink) const {
+    if (index >= frames_.size() || frames_[index].compressed_offset > size) {
+        return false;
+    }
+    std::unique_ptr<ZSTD_DCtx, DCtxDeleter> dctx(ZSTD_createDCtx());
+    if (!dctx) {
+        return false;
+    }
+
+    const size_t offset = frames_[index].compressed_offset;
+    ZSTD_inBuffer input{data + offset, size - offset, 0};
+    std::vector<char> out(ZSTD_DStreamOutSize());
+    while (true) {
+        ZSTD_outBuffer output{out.data(), out.size(), 0};
+        size_t ret = ZSTD_decompressStream(dctx.get(), &output, &input);
+        if (ZSTD_isError(ret)) {
+            return false;
+        }
+        if (output.pos > 0 && !sink(out.data(), output.pos)) {
+            return true;
+        }
+        if (input.pos == input.size && output.pos < output.size) {
+            // A nonzero hint means the last frame was cut short
+            return ret == 0;
+        }
+    }
+}
+
+} // namespace logai
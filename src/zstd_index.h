@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace logai {
+
+/**
+ * @brief Frame layout of a zstd file.
+ *
+ * Zstd frames decode independently, so a file written as several frames
+ * (the seekable format, or `zstd` output concatenated by log rotation) can
+ * be decompressed in parallel, one run of frames per worker. The frame
+ * list comes from the seekable format's seek table when the file ends with
+ * one, otherwise from walking the frame headers, which touches only a few
+ * bytes per block and needs no sidecar.
+ */
+class ZstdIndex {
+public:
+    struct Frame {
+        uint64_t compressed_offset = 0;
+        uint64_t compressed_size = 0;
+        uint64_t uncompressed_offset = 0;
+        uint64_t uncompressed_size = 0;
+    };
+
+    /**
+     * @brief List the data frames of a zstd file held in memory.
+     *
+     * @return bool False if the data is not a well-formed zstd file
+     */
+    bool build(const unsigned char* data, size_t size);
+
+    /**
+     * @brief Decompress from frame `index` onwards, across frame boundaries.
+     *
+     * Output is passed to `sink` in pieces until it returns false or the
+     * data ends.
+     *
+     * @return bool False on a corrupt frame
+     */
+    bool extract(const unsigned char* data, size_t size, size_t index,
+                 const std::function<bool(const char*, size_t)>& sink) const;
+
+    const std::vector<Frame>& frames() const { return frames_; }
+    uint64_t uncompressed_size() const { return uncompressed_size_; }
+
+    /**
+     * False if some frame does not record its decompressed size (streamed
+     * output), in which case uncompressed offsets are not known.
+     */
+    bool sizes_known() const { return sizes_known_; }
+
+private:
+    bool read_seek_table(const unsigned char* data, size_t size);
+
+    std::vector<Frame> frames_;
+    uint64_t uncompressed_size_ = 0;
+    bool sizes_known_ = true;
+};
+
+} // namespace logai
@@ -0,0 +1,141 @@
+#include "bounded_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace logai {
+namespace {
+
+TEST(BoundedQueueTest, RoundsCapacityUpAndReportsFull) {
+    BoundedQueue<int> queue(5);
+    ASSERT_EQ(queue.capacity(), 8u);
+    for (int i = 0; i < 8; ++i) {
+        int value = i;
+        ASSERT_TRUE(queue.try_push(value));
+    }
+    int extra = 99;
+    EXPECT_FALSE(queue.try_push(extra));
+    EXPECT_EQ(extra, 99);
+    EXPECT_EQ(queue.size(), 8u);
+
+    int value = -1;
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(BoundedQueueTest, ManyProducersAndConsumersLoseNothing) {
+    constexpr size_t kProducers = 4;
+    constexpr size_t kConsumers = 4;
+    constexpr uint64_t kPerProducer = 200000;
+    // A small ring keeps producers blocking on a full queue and consumers
+    // on an empty one throughout
+    BoundedQueue<uint64_t> queue(16);
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint64_t i = 0; i < kPerProducer; ++i) {
+                queue.push(p * kPerProducer + i + 1);
+            }
+        });
+    }
+    std::atomic<uint64_t> popped{0};
+    std::atomic<uint64_t> sum{0};
+    std::vector<std::thread> consumers;
+    for (size_t c = 0; c < kConsumers; ++c) {
+        consumers.emplace_back([&]() {
+            uint64_t count = 0;
+            uint64_t local = 0;
+            uint64_t value = 0;
+            while (queue.wait_and_pop(value)) {
+                count++;
+                local += value;
+            }
+            popped += count;
+            sum += local;
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    queue.done();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    const uint64_t total = kProducers * kPerProducer;
+    EXPECT_EQ(popped.load(), total);
+    EXPECT_EQ(sum.load(), total * (total + 1) / 2);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(BoundedQueueTest, KeepsEachProducersOrder) {
+    constexpr uint64_t kPerProducer = 100000;
+    BoundedQueue<uint64_t> queue(8);
+    std::thread first([&]() {
+        for (uint64_t i = 0; i < kPerProducer; ++i) {
+            queue.push(i << 1);
+        }
+    });
+    std::thread second([&]() {
+        for (uint64_t i = 0; i < kPerProducer; ++i) {
+            queue.push((i << 1) | 1);
+        }
+    });
+
+    // A single consumer sees every producer's items in the order pushed
+    uint64_t next[2] = {0, 0};
+    uint64_t value = 0;
+    for (uint64_t n = 0; n < 2 * kPerProducer; ++n) {
+        ASSERT_TRUE(queue.wait_and_pop(value));
+        const uint64_t producer = value & 1;
+        ASSERT_EQ(value >> 1, next[producer]);
+        next[producer]++;
+    }
+    first.join();
+    second.join();
+}
+
+TEST(BoundedQueueTest, DoneWakesWaitingConsumers) {
+    BoundedQueue<int> queue(4);
+    std::atomic<size_t> finished{0};
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; ++i) {
+        consumers.emplace_back([&]() {
+            int value = 0;
+            EXPECT_FALSE(queue.wait_and_pop(value));
+            finished++;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(finished.load(), 0u);
+    queue.done();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+    EXPECT_EQ(finished.load(), 4u);
+}
+
+TEST(BoundedQueueTest, DrainsItemsPushedBeforeDone) {
+    BoundedQueue<int> queue(4);
+    queue.push(1);
+    queue.push(2);
+    queue.done();
+    int value = 0;
+    ASSERT_TRUE(queue.wait_and_pop(value));
+    EXPECT_EQ(value, 1);
+    ASSERT_TRUE(queue.wait_and_pop(value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(queue.wait_and_pop(value));
+}
+
+} // namespace
+} // namespace logai
@@ -0,0 +1,263 @@
+#include "drain_parser.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+namespace {
+
+// Letters only, so the tokens are never taken for numbers
+std::string word(size_t n) {
+    std::string text;
+    do {
+        text.push_back(static_cast<char>('a' + n % 26));
+        n /= 26;
+    } while (n > 0);
+    return "w" + text;
+}
+
+// Line `i` of template `k`: five fixed words plus a user name and a number
+// that vary, so each template ends up as "... <*> ... <*>"
+std::string make_line(size_t k, size_t i) {
+    static const char* const users[] = {"alice", "bob", "carol", "dave"};
+    std::string line;
+    for (size_t j = 0; j < 5; ++j) {
+        line += word(k * 8 + j) + " ";
+    }
+    line += users[i % 4];
+    line += " " + std::to_string(i * 37 % 1000);
+    return line;
+}
+
+std::vector<std::string> make_lines(size_t templates, size_t per_template) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < per_template; ++i) {
+        for (size_t k = 0; k < templates; ++k) {
+            lines.push_back(make_line(k, i));
+        }
+    }
+    return lines;
+}
+
+DrainBatchResult parse_all(DrainParser& parser, const std::vector<std::string>& lines) {
+    std::vector<std::string_view> views(lines.begin(), lines.end());
+    DrainBatchResult out;
+    parser.parse_batch(folly::Range<const std::string_view*>(views.data(), views.size()), out);
+    return out;
+}
+
+std::set<std::string> template_set(const DrainParser& parser) {
+    std::set<std::string> templates;
+    for (const auto& [id, text] : parser.get_all_templates()) {
+        templates.insert(text);
+    }
+    return templates;
+}
+
+// Lines that share a cluster, as groups of line indices, so two parsers can
+// be compared whatever IDs they chose
+std::set<std::vector<size_t>> partition(const DrainParser& parser, const std::vector<std::string>& lines) {
+    std::map<int, std::vector<size_t>> groups;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        groups[parser.get_cluster_id_for_log(lines[i])].push_back(i);
+    }
+    std::set<std::vector<size_t>> result;
+    for (auto& [id, members] : groups) {
+        EXPECT_GE(id, 0);
+        result.insert(std::move(members));
+    }
+    return result;
+}
+
+TEST(DrainParserTest, ConcurrentParseMatchesSerial) {
+    const auto lines = make_lines(40, 50);
+    DataLoaderConfig config;
+
+    DrainParser serial(config);
+    parse_all(serial, lines);
+
+    DrainParser concurrent(config);
+    constexpr size_t kThreads = 8;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            // Interleave single lines and batches on the same tree
+            for (size_t i = t; i < lines.size(); i += kThreads) {
+                if (i % 3 == 0) {
+                    concurrent.parse(lines[i]);
+                } else {
+                    parse_all(concurrent, {lines[i]});
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(concurrent.get_all_templates().size(), 40u);
+    EXPECT_EQ(template_set(concurrent), template_set(serial));
+    EXPECT_EQ(partition(concurrent, lines), partition(serial, lines));
+}
+
+TEST(DrainParserTest, FreezeAndThawKeepLookups) {
+    const auto lines = make_lines(20, 10);
+    DrainParser parser{DataLoaderConfig()};
+    parse_all(parser, lines);
+
+    std::vector<int> live;
+    for (const auto& line : lines) {
+        live.push_back(parser.get_cluster_id_for_log(line));
+    }
+    parser.freeze();
+    ASSERT_TRUE(parser.is_frozen());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        ASSERT_EQ(parser.get_cluster_id_for_log(lines[i]), live[i]) << lines[i];
+    }
+
+    // Clusters learned after freezing are only visible to the live tree
+    const std::string novel = make_line(99, 0);
+    const int learned = parse_all(parser, {novel}).cluster_ids[0];
+    EXPECT_NE(parser.get_cluster_id_for_log(novel), learned);
+
+    parser.thaw();
+    EXPECT_FALSE(parser.is_frozen());
+    EXPECT_EQ(parser.get_cluster_id_for_log(novel), learned);
+    for (size_t i = 0; i < lines.size(); ++i) {
+        ASSERT_EQ(parser.get_cluster_id_for_log(lines[i]), live[i]);
+    }
+
+    parser.freeze();
+    EXPECT_EQ(parser.get_cluster_id_for_log(novel), learned);
+}
+
+TEST(DrainParserTest, SnapshotRoundTrip) {
+    const fs::path path = fs::temp_directory_path() / ("logai_drain_test_" + std::to_string(getpid()) + ".snap");
+    const auto lines = make_lines(30, 10);
+    DrainParser trained{DataLoaderConfig()};
+    parse_all(trained, lines);
+    ASSERT_TRUE(trained.save_snapshot(path.string()));
+
+    DrainParser loaded{DataLoaderConfig()};
+    ASSERT_TRUE(loaded.load_snapshot(path.string()));
+    EXPECT_EQ(loaded.get_all_templates(), trained.get_all_templates());
+    for (const auto& line : lines) {
+        ASSERT_EQ(loaded.get_cluster_id_for_log(line), trained.get_cluster_id_for_log(line)) << line;
+    }
+
+    // Learning resumes where the snapshot left off: known lines keep their
+    // IDs and new templates get IDs past every saved one
+    const auto again = parse_all(loaded, {lines[0], make_line(77, 0)});
+    EXPECT_EQ(again.cluster_ids[0], trained.get_cluster_id_for_log(lines[0]));
+    int highest = 0;
+    for (const auto& [id, text] : trained.get_all_templates()) {
+        highest = std::max(highest, id);
+    }
+    EXPECT_GT(again.cluster_ids[1], highest);
+
+    // A damaged snapshot is refused rather than half loaded
+    fs::resize_file(path, fs::file_size(path) / 2);
+    DrainParser damaged{DataLoaderConfig()};
+    EXPECT_FALSE(damaged.load_snapshot(path.string()));
+    fs::remove(path);
+}
+
+TEST(DrainParserTest, MergeRemapIsDeterministic) {
+    // Both sides know templates 0-9; only `other` knows 10-19
+    const auto shared = make_lines(10, 5);
+    std::vector<std::string> extra;
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t k = 10; k < 20; ++k) {
+            extra.push_back(make_line(k, i));
+        }
+    }
+    std::vector<std::string> other_lines = extra;
+    other_lines.insert(other_lines.end(), shared.begin(), shared.end());
+
+    DrainParser other{DataLoaderConfig()};
+    parse_all(other, other_lines);
+
+    folly::F14FastMap<int, int> remaps[2];
+    folly::F14FastMap<int, std::string> templates[2];
+    for (int run = 0; run < 2; ++run) {
+        DrainParser base{DataLoaderConfig()};
+        parse_all(base, shared);
+        remaps[run] = base.merge(other);
+        templates[run] = base.get_all_templates();
+
+        // Every one of other's clusters maps to a live cluster with the same template
+        const auto other_templates = other.get_all_templates();
+        ASSERT_EQ(remaps[run].size(), other_templates.size());
+        for (const auto& [from, to] : remaps[run]) {
+            ASSERT_TRUE(templates[run].count(to));
+            EXPECT_EQ(templates[run].at(to), other_templates.at(from));
+        }
+        // Templates both sides knew map onto the base's own clusters
+        for (const auto& line : shared) {
+            EXPECT_EQ(remaps[run].at(other.get_cluster_id_for_log(line)), base.get_cluster_id_for_log(line));
+        }
+    }
+    EXPECT_EQ(templates[0].size(), 20u);
+    EXPECT_EQ(remaps[0], remaps[1]);
+    EXPECT_EQ(templates[0], templates[1]);
+}
+
+TEST(DrainParserTest, EvictsLeastRecentlyMatchedBeyondCap) {
+    DrainParser parser{DataLoaderConfig()};
+    parser.setMaxClusters(10);
+    const std::string keep = make_line(0, 0);
+    for (size_t k = 0; k < 100; ++k) {
+        parse_all(parser, {make_line(k, 0), make_line(k, 1)});
+        // Template 0 stays recently matched throughout
+        parse_all(parser, {keep});
+        ASSERT_LE(parser.get_all_templates().size(), 10u);
+    }
+
+    const auto templates = parser.get_all_templates();
+    EXPECT_EQ(templates.size(), 10u);
+    EXPECT_GE(parser.get_cluster_id_for_log(keep), 0);
+    EXPECT_GE(parser.get_cluster_id_for_log(make_line(99, 0)), 0);
+    EXPECT_LT(parser.get_cluster_id_for_log(make_line(50, 0)), 0);
+    EXPECT_LE(parser.memory_usage().clusters, 10u);
+}
+
+TEST(DrainParserTest, CountsHitsPerCluster) {
+    DrainParser parser{DataLoaderConfig()};
+    const auto out = parse_all(parser, make_lines(3, 7));
+    const int first = out.cluster_ids[0];
+
+    auto stats = parser.get_cluster_stats(first, 5);
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_EQ(stats->cluster_id, first);
+    EXPECT_EQ(stats->count, 7u);
+    EXPECT_GT(stats->first_seen_ms, 0);
+    EXPECT_GE(stats->last_seen_ms, stats->first_seen_ms);
+    ASSERT_EQ(stats->per_minute.size(), 5u);
+    // Minute boundaries may fall inside the test
+    EXPECT_EQ(stats->per_minute[0] + stats->per_minute[1], 7u);
+    EXPECT_EQ(stats->log_template, parser.get_template_for_cluster_id(first).value());
+
+    const auto all = parser.get_all_cluster_stats();
+    ASSERT_EQ(all.size(), 3u);
+    uint64_t total = 0;
+    for (size_t i = 0; i < all.size(); ++i) {
+        total += all[i].count;
+        if (i > 0) {
+            EXPECT_LT(all[i - 1].cluster_id, all[i].cluster_id);
+        }
+    }
+    EXPECT_EQ(total, 21u);
+    EXPECT_FALSE(parser.get_cluster_stats(12345).has_value());
+}
+
+} // namespace
+} // namespace logai
@@ -0,0 +1,186 @@
+#include "file_follower.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+namespace {
+
+class FileFollowerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / ("logai_follow_test_" + std::to_string(getpid()));
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        log_ = (dir_ / "app.log").string();
+        checkpoint_ = (dir_ / "follow.ckpt").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir_);
+    }
+
+    static void append(const std::string& path, const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << text;
+    }
+
+    FileFollower::LineCallback collect() {
+        return [this](const std::string&, std::string_view line, const FileFollower::Position& end) {
+            lines_.emplace_back(line);
+            positions_.push_back(end);
+        };
+    }
+
+    static FileFollower::Options manual_commit() {
+        FileFollower::Options options;
+        options.auto_commit = false;
+        return options;
+    }
+
+    fs::path dir_;
+    std::string log_;
+    std::string checkpoint_;
+    std::vector<std::string> lines_;
+    std::vector<FileFollower::Position> positions_;
+};
+
+TEST_F(FileFollowerTest, HoldsBackPartialLines) {
+    FileFollower follower;
+    follower.add(log_);
+    append(log_, "one\ntw");
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    append(log_, "o\n");
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    EXPECT_EQ(lines_, (std::vector<std::string>{"one", "two"}));
+}
+
+TEST_F(FileFollowerTest, ResumesAfterAppendWithPartialLine) {
+    append(log_, "one\ntwo\nthr");
+    {
+        FileFollower follower(checkpoint_);
+        follower.add(log_);
+        EXPECT_EQ(follower.poll(0, collect()), 2u);
+    }
+    append(log_, "ee\nfour\n");
+    FileFollower follower(checkpoint_);
+    follower.add(log_);
+    EXPECT_EQ(follower.poll(0, collect()), 2u);
+    EXPECT_EQ(lines_, (std::vector<std::string>{"one", "two", "three", "four"}));
+}
+
+TEST_F(FileFollowerTest, ResumesAtOldestUncommittedLine) {
+    append(log_, "a\nb\nc\n");
+    {
+        FileFollower follower(checkpoint_, manual_commit());
+        follower.add(log_);
+        ASSERT_EQ(follower.poll(0, collect()), 3u);
+        // "b" was delivered but never consumed
+        follower.commit(log_, positions_[0]);
+        follower.commit(log_, positions_[2]);
+    }
+    lines_.clear();
+    positions_.clear();
+    {
+        FileFollower follower(checkpoint_, manual_commit());
+        follower.add(log_);
+        ASSERT_EQ(follower.poll(0, collect()), 2u);
+        EXPECT_EQ(lines_, (std::vector<std::string>{"b", "c"}));
+        follower.commit(log_, positions_[0]);
+        follower.commit(log_, positions_[1]);
+    }
+    lines_.clear();
+    FileFollower follower(checkpoint_, manual_commit());
+    follower.add(log_);
+    EXPECT_EQ(follower.poll(0, collect()), 0u);
+}
+
+TEST_F(FileFollowerTest, IgnoresCorruptCheckpoint) {
+    append(log_, "a\nb\n");
+    {
+        FileFollower follower(checkpoint_);
+        follower.add(log_);
+        follower.poll(0, collect());
+    }
+    // Cut the checkpoint short: the follower must start over, not misread it
+    const auto size = fs::file_size(checkpoint_);
+    fs::resize_file(checkpoint_, size - 3);
+    lines_.clear();
+    {
+        FileFollower follower(checkpoint_);
+        follower.add(log_);
+        EXPECT_EQ(follower.poll(0, collect()), 2u);
+    }
+
+    std::ofstream(checkpoint_, std::ios::binary | std::ios::trunc) << "not a checkpoint";
+    lines_.clear();
+    FileFollower follower(checkpoint_);
+    follower.add(log_);
+    EXPECT_EQ(follower.poll(0, collect()), 2u);
+}
+
+TEST_F(FileFollowerTest, RereadsTruncatedFile) {
+    FileFollower follower;
+    follower.add(log_);
+    append(log_, "first\nsecond\n");
+    follower.poll(0, collect());
+    std::ofstream(log_, std::ios::binary | std::ios::trunc) << "x\n";
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    EXPECT_EQ(lines_.back(), "x");
+}
+
+TEST_F(FileFollowerTest, DrainsRotatedFileUntilIdle) {
+    FileFollower::Options options;
+    options.rotate_grace_ms = 200;
+    FileFollower follower("", options);
+    follower.add(log_);
+    append(log_, "old1\ntail");
+    follower.poll(0, collect());
+    const std::string rotated = log_ + ".1";
+    ASSERT_EQ(std::rename(log_.c_str(), rotated.c_str()), 0);
+    append(log_, "new1\n");
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    EXPECT_EQ(lines_.back(), "new1");
+
+    // The writer finishes its last burst into the renamed file
+    append(rotated, "X\nlast");
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    EXPECT_EQ(lines_.back(), "tailX");
+
+    // Once idle for the grace period its unterminated last line is flushed
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(follower.poll(0, collect()), 1u);
+    EXPECT_EQ(lines_.back(), "last");
+    append(rotated, "ignored\n");
+    EXPECT_EQ(follower.poll(0, collect()), 0u);
+}
+
+TEST_F(FileFollowerTest, NegativeTimeoutWaitsForLines) {
+    FileFollower::Options options;
+    options.poll_interval_ms = 20;
+    FileFollower follower("", options);
+    follower.add(log_);
+    std::thread writer([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        append(log_, "late\n");
+    });
+    EXPECT_EQ(follower.poll(-1, collect()), 1u);
+    writer.join();
+    EXPECT_EQ(lines_.back(), "late");
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(follower.poll(100, collect()), 0u);
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(90));
+}
+
+} // namespace
+} // namespace logai
@@ -0,0 +1,133 @@
+#include "file_data_loader.h"
+#include "gzip_index.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <zlib.h>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+namespace {
+
+class GzipIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / ("logai_gzip_test_" + std::to_string(getpid()));
+        fs::create_directories(dir_);
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir_);
+    }
+
+    // Lines of varying length, so some cross every checkpoint boundary
+    static std::vector<std::string> make_lines(size_t count) {
+        std::vector<std::string> lines;
+        for (size_t i = 0; i < count; ++i) {
+            lines.push_back("request " + std::to_string(i) + " served by worker" + std::to_string(i % 13) +
+                            " in " + std::to_string(i * 7 % 1000) + " ms " + std::string(i % 97, 'x'));
+        }
+        return lines;
+    }
+
+    static std::string join(const std::vector<std::string>& lines) {
+        std::string text;
+        for (const auto& line : lines) {
+            text += line;
+            text += '\n';
+        }
+        return text;
+    }
+
+    // Write `parts` as consecutive gzip members, as `cat a.gz b.gz` would
+    std::string write_members(const std::vector<std::string>& parts) {
+        const std::string path = (dir_ / "members.log.gz").string();
+        for (size_t i = 0; i < parts.size(); ++i) {
+            gzFile file = gzopen(path.c_str(), i == 0 ? "wb" : "ab");
+            EXPECT_NE(file, nullptr);
+            EXPECT_EQ(gzwrite(file, parts[i].data(), static_cast<unsigned>(parts[i].size())),
+                      static_cast<int>(parts[i].size()));
+            gzclose(file);
+        }
+        return path;
+    }
+
+    static std::string read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    fs::path dir_;
+};
+
+TEST_F(GzipIndexTest, ExtractsAcrossConcatenatedMembers) {
+    const std::string first = join(make_lines(20000));
+    const std::string second = join(make_lines(5000));
+    const std::string third = join(make_lines(30000));
+    const std::string path = write_members({first, second, third});
+    const std::string compressed = read_file(path);
+    const auto* data = reinterpret_cast<const unsigned char*>(compressed.data());
+    const std::string text = first + second + third;
+
+    GzipIndex index;
+    ASSERT_TRUE(index.build(data, compressed.size(), 256 * 1024));
+    EXPECT_EQ(index.uncompressed_size(), text.size());
+    ASSERT_GT(index.checkpoints().size(), 3u);
+
+    // Every checkpoint resumes at the right place, including those in later members
+    for (size_t i = 0; i < index.checkpoints().size(); ++i) {
+        const uint64_t start = index.checkpoints()[i].uncompressed_offset;
+        std::string out;
+        ASSERT_TRUE(index.extract(data, compressed.size(), i, [&](const char* chunk, size_t size) {
+            out.append(chunk, size);
+            return true;
+        }));
+        EXPECT_EQ(out, text.substr(start)) << "checkpoint " << i;
+    }
+}
+
+TEST_F(GzipIndexTest, SidecarRoundTrip) {
+    const std::string path = write_members({join(make_lines(20000)), join(make_lines(20000))});
+
+    GzipIndex built;
+    ASSERT_TRUE(built.open(path, true, 256 * 1024));
+    GzipIndex loaded;
+    ASSERT_TRUE(loaded.load_sidecar(path));
+    ASSERT_EQ(loaded.checkpoints().size(), built.checkpoints().size());
+    EXPECT_EQ(loaded.uncompressed_size(), built.uncompressed_size());
+    for (size_t i = 0; i < built.checkpoints().size(); ++i) {
+        EXPECT_EQ(loaded.checkpoints()[i].uncompressed_offset, built.checkpoints()[i].uncompressed_offset);
+        EXPECT_EQ(loaded.checkpoints()[i].window, built.checkpoints()[i].window);
+    }
+}
+
+TEST_F(GzipIndexTest, LoaderParsesLinesStraddlingRegionsOnce) {
+    // Several MB across two members with 1 MB checkpoints: lines cross both
+    // checkpoint and member boundaries, and regions are split between workers
+    const auto lines = make_lines(60000);
+    const std::vector<std::string> head(lines.begin(), lines.begin() + 25000);
+    const std::vector<std::string> tail(lines.begin() + 25000, lines.end());
+    const std::string path = write_members({join(head), join(tail)});
+
+    FileDataLoaderConfig config;
+    config.file_path = path;
+    config.log_type = "drain";
+    config.num_threads = 4;
+    config.gzip_checkpoint_span_mb = 1;
+    FileDataLoader loader(path, config);
+    const auto records = loader.load_data();
+
+    ASSERT_EQ(records.size(), lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        ASSERT_EQ(records[i].body, lines[i]) << "record " << i;
+    }
+}
+
+} // namespace
+} // namespace logai
@@ -0,0 +1,166 @@
+#include "file_data_loader.h"
+#include "ingest_checkpoint.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+namespace {
+
+class IngestCheckpointTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / ("logai_ingest_test_" + std::to_string(getpid()));
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        log_ = (dir_ / "app.log").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir_);
+    }
+
+    static void append(const std::string& path, const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << text;
+    }
+
+    static std::string lines(size_t first, size_t count) {
+        std::string text;
+        for (size_t i = first; i < first + count; ++i) {
+            text += "job " + std::to_string(i) + " finished on worker w" + std::to_string(i % 7) + "\n";
+            text += "cache miss for key k" + std::to_string(i) + " in region r" + std::to_string(i % 3) + "\n";
+        }
+        return text;
+    }
+
+    std::vector<LogRecordObject> load_incremental(double similarity_threshold = 0.5) {
+        FileDataLoaderConfig config;
+        config.file_path = log_;
+        config.log_type = "drain";
+        config.num_threads = 4;
+        config.incremental = true;
+        config.drain_similarity_threshold = similarity_threshold;
+        FileDataLoader loader(log_, config);
+        return loader.load_data();
+    }
+
+    fs::path dir_;
+    std::string log_;
+};
+
+TEST_F(IngestCheckpointTest, SidecarRoundTrip) {
+    IngestCheckpoint saved;
+    saved.inode = 42;
+    saved.offset = 1234;
+    saved.prefix_hash = 0xfeedface;
+    saved.fingerprint = 7;
+    ASSERT_TRUE(saved.save_sidecar(log_));
+
+    IngestCheckpoint loaded;
+    ASSERT_TRUE(loaded.load_sidecar(log_));
+    EXPECT_EQ(loaded.inode, saved.inode);
+    EXPECT_EQ(loaded.offset, saved.offset);
+    EXPECT_EQ(loaded.prefix_hash, saved.prefix_hash);
+    EXPECT_EQ(loaded.fingerprint, saved.fingerprint);
+}
+
+TEST_F(IngestCheckpointTest, RejectsTruncatedOrCorruptSidecar) {
+    IngestCheckpoint saved;
+    saved.offset = 10;
+    ASSERT_TRUE(saved.save_sidecar(log_));
+    const std::string sidecar = IngestCheckpoint::sidecar_path(log_);
+
+    fs::resize_file(sidecar, fs::file_size(sidecar) - 1);
+    IngestCheckpoint truncated;
+    EXPECT_FALSE(truncated.load_sidecar(log_));
+
+    std::ofstream(sidecar, std::ios::binary | std::ios::trunc) << std::string(64, 'z');
+    IngestCheckpoint corrupt;
+    EXPECT_FALSE(corrupt.load_sidecar(log_));
+}
+
+TEST_F(IngestCheckpointTest, MatchesOnlyAnUnchangedPrefix) {
+    const std::string text = lines(0, 100);
+    IngestCheckpoint checkpoint;
+    checkpoint.inode = 5;
+    checkpoint.offset = text.size() / 2;
+    checkpoint.prefix_hash = IngestCheckpoint::hash_prefix(text.data(), checkpoint.offset);
+    checkpoint.fingerprint = 9;
+
+    const std::string appended = text + lines(100, 10);
+    EXPECT_TRUE(checkpoint.matches(appended.data(), appended.size(), 5, 9));
+    EXPECT_FALSE(checkpoint.matches(appended.data(), appended.size(), 6, 9));
+    EXPECT_FALSE(checkpoint.matches(appended.data(), appended.size(), 5, 10));
+    EXPECT_FALSE(checkpoint.matches(text.data(), checkpoint.offset - 1, 5, 9));
+
+    std::string rewritten = appended;
+    rewritten[0] = 'J';
+    EXPECT_FALSE(checkpoint.matches(rewritten.data(), rewritten.size(), 5, 9));
+}
+
+TEST_F(IngestCheckpointTest, ResumesAfterAppend) {
+    append(log_, lines(0, 500));
+    const auto first = load_incremental();
+    ASSERT_EQ(first.size(), 1000u);
+
+    // A trailing line without its newline waits for the next run
+    append(log_, lines(500, 50) + "job 550 finished");
+    const auto second = load_incremental();
+    ASSERT_EQ(second.size(), 100u);
+    EXPECT_EQ(second.front().body, "job 500 finished on worker w3");
+
+    // Appended lines land in the clusters learned by the first run
+    EXPECT_EQ(second[0].get_field("cluster_id"), first[0].get_field("cluster_id"));
+    EXPECT_EQ(second[1].get_field("cluster_id"), first[1].get_field("cluster_id"));
+
+    append(log_, " on worker w4\n");
+    const auto third = load_incremental();
+    ASSERT_EQ(third.size(), 1u);
+    EXPECT_EQ(third.front().body, "job 550 finished on worker w4");
+
+    EXPECT_TRUE(load_incremental().empty());
+}
+
+TEST_F(IngestCheckpointTest, ReparsesWithoutDrainSnapshot) {
+    append(log_, lines(0, 100));
+    ASSERT_EQ(load_incremental().size(), 200u);
+    append(log_, lines(100, 10));
+    // Without the clusters learned so far, resuming would renumber them
+    fs::remove(IngestCheckpoint::drain_snapshot_path(log_));
+    EXPECT_EQ(load_incremental().size(), 220u);
+}
+
+TEST_F(IngestCheckpointTest, ReparsesWithCorruptSidecar) {
+    append(log_, lines(0, 100));
+    ASSERT_EQ(load_incremental().size(), 200u);
+    append(log_, lines(100, 10));
+    std::ofstream(IngestCheckpoint::sidecar_path(log_), std::ios::binary | std::ios::trunc) << "garbage";
+    EXPECT_EQ(load_incremental().size(), 220u);
+}
+
+TEST_F(IngestCheckpointTest, ReparsesRewrittenFile) {
+    append(log_, lines(0, 100));
+    ASSERT_EQ(load_incremental().size(), 200u);
+    std::ofstream(log_, std::ios::binary | std::ios::trunc) << lines(1000, 150);
+    EXPECT_EQ(load_incremental().size(), 300u);
+}
+
+TEST_F(IngestCheckpointTest, ReparsesWithChangedDrainSettings) {
+    append(log_, lines(0, 100));
+    ASSERT_EQ(load_incremental(0.5).size(), 200u);
+    append(log_, lines(100, 10));
+    // The snapshot's tree was built with the old threshold
+    EXPECT_EQ(load_incremental(0.7).size(), 220u);
+    append(log_, lines(110, 10));
+    EXPECT_EQ(load_incremental(0.7).size(), 20u);
+}
+
+} // namespace
+} // namespace logai
@@ -0,0 +1,126 @@
+#include "reorder_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace logai {
+namespace {
+
+TEST(ReorderBufferTest, PopsInSequenceWhateverThePutOrder) {
+    ReorderBuffer<int> buffer(8);
+    std::vector<size_t> order = {3, 1, 0, 7, 2, 6, 4, 5};
+    for (size_t sequence : order) {
+        ASSERT_TRUE(buffer.wait_for_room(sequence, []() { return false; }));
+        buffer.put(sequence, static_cast<int>(sequence) * 10);
+    }
+    buffer.finish(order.size());
+
+    int value = -1;
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_TRUE(buffer.pop(value));
+        EXPECT_EQ(value, i * 10);
+    }
+    EXPECT_FALSE(buffer.pop(value));
+    EXPECT_EQ(buffer.next(), 8u);
+}
+
+TEST(ReorderBufferTest, DeliversInOrderFromManyProducers) {
+    constexpr size_t kCount = 100000;
+    constexpr size_t kProducers = 4;
+    ReorderBuffer<size_t> buffer(16);
+
+    // Producers claim sequence numbers in order but finish them out of order
+    std::atomic<size_t> claimed{0};
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            std::mt19937 rng(static_cast<unsigned>(p));
+            while (true) {
+                const size_t sequence = claimed.fetch_add(1);
+                if (sequence >= kCount) {
+                    return;
+                }
+                if (!buffer.wait_for_room(sequence, []() { return false; })) {
+                    return;
+                }
+                if (rng() % 64 == 0) {
+                    std::this_thread::yield();
+                }
+                buffer.put(sequence, sequence);
+            }
+        });
+    }
+    std::thread finisher([&]() {
+        for (auto& producer : producers) {
+            producer.join();
+        }
+        buffer.finish(kCount);
+    });
+
+    size_t value = 0;
+    size_t expected = 0;
+    while (buffer.pop(value)) {
+        ASSERT_EQ(value, expected);
+        expected++;
+    }
+    finisher.join();
+    EXPECT_EQ(expected, kCount);
+}
+
+TEST(ReorderBufferTest, HoldsProducersToTheWindow) {
+    constexpr size_t kWindow = 4;
+    ReorderBuffer<int> buffer(kWindow);
+    for (size_t sequence = 0; sequence < kWindow; ++sequence) {
+        ASSERT_TRUE(buffer.wait_for_room(sequence, []() { return false; }));
+        buffer.put(sequence, 0);
+    }
+
+    // Sequence kWindow would reuse the slot of the unpopped 0
+    std::atomic<bool> admitted{false};
+    std::atomic<size_t> idle_calls{0};
+    std::thread producer([&]() {
+        EXPECT_TRUE(buffer.wait_for_room(kWindow, [&]() {
+            idle_calls++;
+            return false;
+        }));
+        admitted = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(admitted.load());
+    EXPECT_GE(idle_calls.load(), 1u);
+
+    int value = 0;
+    ASSERT_TRUE(buffer.pop(value));
+    producer.join();
+    EXPECT_TRUE(admitted.load());
+}
+
+TEST(ReorderBufferTest, CancelReleasesWaitingProducer) {
+    ReorderBuffer<int> buffer(1);
+    ASSERT_TRUE(buffer.wait_for_room(0, []() { return false; }));
+    buffer.put(0, 1);
+    std::thread producer([&]() {
+        EXPECT_FALSE(buffer.wait_for_room(1, []() { return false; }));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    buffer.cancel();
+    producer.join();
+}
+
+TEST(ReorderBufferTest, FinishWakesWaitingConsumer) {
+    ReorderBuffer<int> buffer(4);
+    std::thread consumer([&]() {
+        int value = 0;
+        EXPECT_FALSE(buffer.pop(value));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    buffer.finish(0);
+    consumer.join();
+}
+
+} // namespace
+} // namespace logai
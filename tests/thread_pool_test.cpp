@@ -0,0 +1,157 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+namespace logai {
+namespace {
+
+ThreadPool::Options pool_options(size_t threads) {
+    ThreadPool::Options options;
+    options.num_threads = threads;
+    return options;
+}
+
+TEST(ThreadPoolTest, RunsEveryTaskOfAGroup) {
+    ThreadPool pool(pool_options(4));
+    std::atomic<size_t> count{0};
+    TaskGroup group(pool);
+    for (int i = 0; i < 10000; ++i) {
+        group.run([&count]() { count++; });
+    }
+    group.wait();
+    EXPECT_EQ(count.load(), 10000u);
+    EXPECT_EQ(group.pending(), 0u);
+}
+
+TEST(ThreadPoolTest, NestedWaitsDoNotDeadlock) {
+    // Far more nested waiters than workers: each must run its own group's
+    // tasks rather than block a worker the inner tasks need
+    ThreadPool pool(pool_options(2));
+    std::atomic<size_t> leaves{0};
+    TaskGroup outer(pool);
+    for (int i = 0; i < 16; ++i) {
+        outer.run([&pool, &leaves]() {
+            TaskGroup middle(pool);
+            for (int j = 0; j < 8; ++j) {
+                middle.run([&pool, &leaves]() {
+                    TaskGroup inner(pool);
+                    for (int k = 0; k < 8; ++k) {
+                        inner.run([&leaves]() { leaves++; });
+                    }
+                    inner.wait();
+                });
+            }
+            middle.wait();
+        });
+    }
+    outer.wait();
+    EXPECT_EQ(leaves.load(), 16u * 8u * 8u);
+}
+
+TEST(ThreadPoolTest, WaitRethrowsTaskException) {
+    ThreadPool pool(pool_options(4));
+    std::atomic<size_t> finished{0};
+    TaskGroup group(pool);
+    for (int i = 0; i < 100; ++i) {
+        group.run([i, &finished]() {
+            if (i % 10 == 3) {
+                throw std::runtime_error("task failed");
+            }
+            finished++;
+        });
+    }
+    EXPECT_THROW(group.wait(), std::runtime_error);
+    // A failure does not cancel the other tasks
+    EXPECT_EQ(finished.load(), 90u);
+
+    // The error was reported once; the group can be reused
+    group.run([&finished]() { finished++; });
+    EXPECT_NO_THROW(group.wait());
+    EXPECT_EQ(finished.load(), 91u);
+}
+
+TEST(ThreadPoolTest, NestedExceptionReachesOuterWaiter) {
+    ThreadPool pool(pool_options(2));
+    TaskGroup outer(pool);
+    outer.run([&pool]() {
+        TaskGroup inner(pool);
+        inner.run([]() { throw std::logic_error("inner"); });
+        inner.wait();
+    });
+    EXPECT_THROW(outer.wait(), std::logic_error);
+}
+
+TEST(ThreadPoolTest, RunOneOnlyRunsTheGroupsTasks) {
+    ThreadPool pool(pool_options(1));
+    // Keep the only worker busy so queued tasks stay unstarted
+    std::atomic<bool> release{false};
+    TaskGroup blocker(pool);
+    blocker.run([&release]() {
+        while (!release.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::atomic<bool> other_ran{false};
+    pool.submit([&other_ran]() { other_ran = true; });
+    std::atomic<size_t> mine{0};
+    TaskGroup group(pool);
+    group.run([&mine]() { mine++; });
+    group.run([&mine]() { mine++; });
+
+    EXPECT_TRUE(group.run_one());
+    EXPECT_TRUE(group.run_one());
+    EXPECT_FALSE(group.run_one());
+    EXPECT_EQ(mine.load(), 2u);
+    EXPECT_FALSE(other_ran.load());
+
+    release = true;
+    group.wait();
+    blocker.wait();
+    while (!other_ran.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+TEST(ThreadPoolTest, WaitBelowLeavesAtMostLimitUnfinished) {
+    ThreadPool pool(pool_options(2));
+    std::atomic<bool> release{false};
+    TaskGroup group(pool);
+    for (int i = 0; i < 4; ++i) {
+        group.run([&release]() {
+            while (!release.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    std::thread releaser([&release]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    group.wait_below(2);
+    EXPECT_LT(group.pending(), 2u);
+    releaser.join();
+    group.wait();
+}
+
+TEST(ThreadPoolTest, ParallelForCoversTheRangeOnce) {
+    ThreadPool pool(pool_options(4));
+    std::vector<std::atomic<int>> hits(100003);
+    pool.parallel_for(0, hits.size(), 1000, [&hits](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            hits[i]++;
+        }
+    });
+    for (const auto& hit : hits) {
+        ASSERT_EQ(hit.load(), 1);
+    }
+}
+
+} // namespace
+} // namespace logai
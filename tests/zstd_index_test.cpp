@@ -0,0 +1,183 @@
+#include "file_data_loader.h"
+#include "zstd_index.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <zstd.h>
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+
+namespace logai {
+namespace {
+
+std::vector<std::string> make_lines(size_t count) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < count; ++i) {
+        lines.push_back("session " + std::to_string(i) + " opened for user u" + std::to_string(i % 29) +
+                        " from 10.0.0." + std::to_string(i % 251) + " " + std::string(i % 61, 'y'));
+    }
+    return lines;
+}
+
+std::string join(const std::vector<std::string>& lines) {
+    std::string text;
+    for (const auto& line : lines) {
+        text += line;
+        text += '\n';
+    }
+    return text;
+}
+
+// One frame per piece of `pieces` bytes, cut regardless of line breaks
+std::string compress_frames(const std::string& text, size_t pieces, std::vector<size_t>* frame_sizes = nullptr) {
+    std::string out;
+    const size_t piece = (text.size() + pieces - 1) / pieces;
+    for (size_t pos = 0; pos < text.size(); pos += piece) {
+        const size_t length = std::min(piece, text.size() - pos);
+        std::string frame(ZSTD_compressBound(length), '\0');
+        size_t size = ZSTD_compress(frame.data(), frame.size(), text.data() + pos, length, 3);
+        EXPECT_FALSE(ZSTD_isError(size));
+        frame.resize(size);
+        out += frame;
+        if (frame_sizes) {
+            frame_sizes->push_back(size);
+        }
+    }
+    return out;
+}
+
+void put_le32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+std::string extract_from(const ZstdIndex& index, const std::string& compressed, size_t frame, bool* ok) {
+    std::string out;
+    *ok = index.extract(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size(), frame,
+                        [&](const char* data, size_t size) {
+                            out.append(data, size);
+                            return true;
+                        });
+    return out;
+}
+
+TEST(ZstdIndexTest, ListsAndExtractsIndependentFrames) {
+    const std::string text = join(make_lines(40000));
+    const std::string compressed = compress_frames(text, 5);
+
+    ZstdIndex index;
+    ASSERT_TRUE(index.build(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size()));
+    ASSERT_EQ(index.frames().size(), 5u);
+    EXPECT_TRUE(index.sizes_known());
+    EXPECT_EQ(index.uncompressed_size(), text.size());
+    for (size_t i = 0; i < index.frames().size(); ++i) {
+        bool ok = false;
+        const std::string out = extract_from(index, compressed, i, &ok);
+        ASSERT_TRUE(ok) << "frame " << i;
+        EXPECT_EQ(out, text.substr(index.frames()[i].uncompressed_offset)) << "frame " << i;
+    }
+}
+
+TEST(ZstdIndexTest, ReadsSeekTable) {
+    const std::string text = join(make_lines(20000));
+    std::vector<size_t> frame_sizes;
+    std::string compressed = compress_frames(text, 4, &frame_sizes);
+
+    // Seekable format: a skippable frame listing every frame, then the footer
+    const uint32_t count = static_cast<uint32_t>(frame_sizes.size());
+    const size_t piece = (text.size() + count - 1) / count;
+    std::string table;
+    for (uint32_t i = 0; i < count; ++i) {
+        put_le32(table, static_cast<uint32_t>(frame_sizes[i]));
+        put_le32(table, static_cast<uint32_t>(std::min(piece, text.size() - i * piece)));
+    }
+    put_le32(table, count);
+    table.push_back('\0');
+    put_le32(table, 0x8F92EAB1);
+    put_le32(compressed, ZSTD_MAGIC_SKIPPABLE_START | 0xE);
+    put_le32(compressed, static_cast<uint32_t>(table.size()));
+    compressed += table;
+
+    ZstdIndex index;
+    ASSERT_TRUE(index.build(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size()));
+    ASSERT_EQ(index.frames().size(), count);
+    EXPECT_EQ(index.uncompressed_size(), text.size());
+    bool ok = false;
+    const size_t last = count - 1;
+    EXPECT_EQ(extract_from(index, compressed, last, &ok), text.substr(index.frames()[last].uncompressed_offset));
+    EXPECT_TRUE(ok);
+}
+
+TEST(ZstdIndexTest, StreamedFrameHasUnknownSize) {
+    const std::string text = join(make_lines(5000));
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    std::string compressed(ZSTD_compressBound(text.size()), '\0');
+    ZSTD_inBuffer input{text.data(), text.size(), 0};
+    ZSTD_outBuffer output{compressed.data(), compressed.size(), 0};
+    // Fed in a separate call from the end, the size is not known up front
+    // and the frame header omits it
+    ASSERT_FALSE(ZSTD_isError(ZSTD_compressStream2(cctx, &output, &input, ZSTD_e_continue)));
+    ZSTD_inBuffer rest{nullptr, 0, 0};
+    ASSERT_EQ(ZSTD_compressStream2(cctx, &output, &rest, ZSTD_e_end), 0u);
+    ZSTD_freeCCtx(cctx);
+    compressed.resize(output.pos);
+
+    ZstdIndex index;
+    ASSERT_TRUE(index.build(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size()));
+    EXPECT_FALSE(index.sizes_known());
+    bool ok = false;
+    EXPECT_EQ(extract_from(index, compressed, 0, &ok), text);
+    EXPECT_TRUE(ok);
+}
+
+TEST(ZstdIndexTest, RejectsCorruptFrame) {
+    const std::string text = join(make_lines(20000));
+    std::string compressed = compress_frames(text, 2);
+    // Damage the middle of the first frame's blocks, past its header
+    for (size_t i = 0; i < 64; ++i) {
+        compressed[compressed.size() / 4 + i] ^= 0x5A;
+    }
+
+    ZstdIndex index;
+    if (!index.build(reinterpret_cast<const unsigned char*>(compressed.data()), compressed.size())) {
+        return;
+    }
+    bool ok = true;
+    const std::string out = extract_from(index, compressed, 0, &ok);
+    EXPECT_TRUE(!ok || out != text);
+}
+
+TEST(ZstdIndexTest, LoaderParsesLinesStraddlingFramesOnce) {
+    const fs::path dir = fs::temp_directory_path() / ("logai_zstd_test_" + std::to_string(getpid()));
+    fs::create_directories(dir);
+    const std::string path = (dir / "frames.log.zst").string();
+    const auto lines = make_lines(50000);
+    {
+        // Frames end mid-line, so regions split between workers must hand
+        // the broken lines over to their neighbours
+        std::ofstream out(path, std::ios::binary);
+        const std::string compressed = compress_frames(join(lines), 16);
+        out.write(compressed.data(), compressed.size());
+    }
+
+    FileDataLoaderConfig config;
+    config.file_path = path;
+    config.log_type = "drain";
+    config.num_threads = 4;
+    FileDataLoader loader(path, config);
+    const auto records = loader.load_data();
+    fs::remove_all(dir);
+
+    ASSERT_EQ(records.size(), lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        ASSERT_EQ(records[i].body, lines[i]) << "record " << i;
+    }
+}
+
+} // namespace
+} // namespace logai